@@ -7,16 +7,24 @@
 
 #define NEVER (ULONG_MAX)
 
+// See blinklib.cpp. Lets the host build know when this timer will go off so it can skip ahead to then.
+
+#ifndef BLINKBIOS_WAKE_HINT
+    #define BLINKBIOS_WAKE_HINT( t )
+#endif
+
 // All Timers come into this world pre-expired, so their expireTime is 0
 // Here we leave the constructor empty and depend in the BBS section clearing
 // to set it to 0 (the constructor mechanism uses lots of flash). 
 
 bool Timer::isExpired() {
+    BLINKBIOS_WAKE_HINT( m_expireTime + 1 );
     return millis() > m_expireTime;
 }
 
 void Timer::set( uint32_t ms ) {
     m_expireTime= millis()+ms;
+    BLINKBIOS_WAKE_HINT( m_expireTime + 1 );
 }
 
 uint32_t Timer::getRemaining() {
@@ -46,13 +46,61 @@
 
 #include "shared/blinkbios_shared_functions.h"     // Gets us ir_send_packet()
 
+// Anywhere we busy-wait for the BIOS to change something in the background, we call BLINKBIOS_SPIN_YIELD().
+// On a tile the BIOS runs from ISRs so there is nothing to do here, but the host build (see `/host`) runs
+// the BIOS cooperatively so it needs us to yield to let it catch up.
+
+#ifndef BLINKBIOS_SPIN_YIELD
+    #define BLINKBIOS_SPIN_YIELD()
+#endif
+
+// BLINKBIOS_WAKE_HINT( t ) tells the BIOS that something we are waiting for will happen when millis gets to `t`.
+// A tile always runs every frame so this also compiles to nothing, but the host build uses it to skip straight
+// over stretches of time when nothing is going to happen (like the 10 minutes before warm sleep).
+
+#ifndef BLINKBIOS_WAKE_HINT
+    #define BLINKBIOS_WAKE_HINT( t )
+#endif
+
 
 #define TX_PROBE_TIME_MS           150     // How often to do a blind send when no RX has happened recently to trigger ping pong
                                            // Nice to have probe time shorter than expire time so you have to miss 2 messages
                                            // before the face will expire
 
+// With BLINKLIB_ADAPTIVE_PROBE (see blinklib.h for the profiles). These can be set with compiler flags too.
+
+#if defined( BLINKLIB_PROBE_LOW_LATENCY ) && defined( BLINKLIB_PROBE_LOW_POWER )
+    #error Pick either BLINKLIB_PROBE_LOW_LATENCY or BLINKLIB_PROBE_LOW_POWER
+#endif
+
+#ifndef TX_PROBE_BUSY_MS
+    #if defined( BLINKLIB_PROBE_LOW_LATENCY )
+        #define TX_PROBE_BUSY_MS        20      // Probe time on a face with something waiting to go out
+    #elif defined( BLINKLIB_PROBE_LOW_POWER )
+        #define TX_PROBE_BUSY_MS       100
+    #else
+        #define TX_PROBE_BUSY_MS        50
+    #endif
+#endif
+
+#ifndef TX_PROBE_IDLE_MAX_MS
+    #if defined( BLINKLIB_PROBE_LOW_LATENCY )
+        #define TX_PROBE_IDLE_MAX_MS   300      // Longest probe time on a face with nobody there. Also how long a new neighbor can take to show up.
+    #elif defined( BLINKLIB_PROBE_LOW_POWER )
+        #define TX_PROBE_IDLE_MAX_MS  1200
+    #else
+        #define TX_PROBE_IDLE_MAX_MS   600
+    #endif
+#endif
+
+#define TX_BACKOFF_MAX_MS          16      // With BLINKLIB_CARRIER_SENSE, wait a random 1 to this many ms before trying again when
+                                           // the neighbor is talking. Must be a power of 2.
+
 #define RX_EXPIRE_TIME_MS         200      // If we do not see a message in this long, then show that face as expired
 
+#define LINK_RESET_TIME_MS       1000      // With BLINKLIB_RELIABLE_DATAGRAMS, if we do not see a message in this long, then
+                                           // assume whoever is there now is a different neighbor and start the sequence over
+
 #define VIRAL_BUTTON_PRESS_LOCKOUT_MS   2000    // Any viral button presses received from IR within this time period are ignored 
                                                 // since insures that a single press can not circulate around indefinitely.                                                
 
@@ -79,6 +127,66 @@
 
 #define NOP_SPECIAL_VALUE   0b00110011
 
+// This is a special byte that signals that this is a fragment of a message (see BLINKLIB_MESSAGES)
+// It is framed just like a datagram, with a fragment header byte in front of the data. Like datagrams
+// these are always >2 bytes so we can tell them from a face value.
+
+#define MESSAGE_FRAGMENT_SPECIAL_VALUE   0b00011011
+
+// This is a special byte that signals a wide face value (see BLINKLIB_WIDE_VALUES). It is framed like a 2 byte
+// datagram (with a checksum) and it is the only thing that ever gets sent with this header, so we can tell it from one.
+
+#define WIDE_VALUE_SPECIAL_VALUE    0b00110110
+
+#define WIDE_VALUE_LEN              2           // Low byte then high byte
+
+#ifdef BLINKLIB_MESSAGES
+    #define IS_DATAGRAM_FRAMED( v ) ( (v) == DATAGRAM_SPECIAL_VALUE || (v) == MESSAGE_FRAGMENT_SPECIAL_VALUE )
+#else
+    #define IS_DATAGRAM_FRAMED( v ) ( (v) == DATAGRAM_SPECIAL_VALUE )
+#endif
+
+// The fragment header byte has the index of this fragment in the message and a flag on the last one
+
+#define MESSAGE_FRAGMENT_INDEX_MASK     0b01111111
+#define MESSAGE_FRAGMENT_LAST_BIT       0b10000000
+
+// With BLINKLIB_RELIABLE_DATAGRAMS, every packet has a link byte right after the header byte that carries
+// the sequence bit of the datagram in this packet (if any) and the acknowledgement for the other direction.
+// The high nibble is the inverse of the low nibble so we can tell a good one on a face value packet,
+// which does not have a checksum. It also means a link byte can never look like one of the special values above.
+
+#define LINK_SEQ_BIT            0b00000001      // Sequence bit of the datagram in this packet
+#define LINK_ACK_BIT            0b00000010      // Sequence bit of the last datagram we accepted from the other side
+#define LINK_READY_BIT          0b00000100      // We have room to take the next one
+#define LINK_EPOCH_BIT          0b00001000      // Flips every time we start our side of the link over
+
+#define LINK_BYTE_ENCODE( b )   ( (b) | ( ( ~(b) & 0x0f ) << 4 ) )
+#define LINK_BYTE_VALID( b )    ( ( (b) >> 4 ) == ( ~(b) & 0x0f ) )
+
+#ifdef BLINKLIB_RELIABLE_DATAGRAMS
+    #define DATAGRAM_LINK_LEN   1
+#else
+    #define DATAGRAM_LINK_LEN   0
+#endif
+
+// With BLINKLIB_DATAGRAM_VALUES, every datagram (and message fragment) also carries the face value right after the
+// link byte, so the neighbor keeps seeing it change while we are busy sending datagrams instead of face values.
+
+#ifdef BLINKLIB_DATAGRAM_VALUES
+    #ifdef BLINKLIB_WIDE_VALUES
+        #define DATAGRAM_VALUE_LEN  WIDE_VALUE_LEN
+    #else
+        #define DATAGRAM_VALUE_LEN  1
+    #endif
+#else
+    #define DATAGRAM_VALUE_LEN  0
+#endif
+
+// Everything between the header byte and the payload. It is all covered by the checksum.
+
+#define DATAGRAM_PREFIX_LEN     ( DATAGRAM_LINK_LEN + DATAGRAM_VALUE_LEN )
+
 
 // We use bit 6 in the IR data to indicate that a button has been pressed so we should 
 // postpone sleeping. This spreads a button press to all connected tiles so 
@@ -93,24 +201,21 @@
     #warning The following code assumes that the top two bits of the header byte are available
 #endif
 
-// Returns true if odd number of bits set
-// TODO: make asm
+// The top bit of each entry is the parity of its index, so 0x80 if the nibble has an odd number of bits set.
+// The parity of a whole byte is then just the parity of its two nibbles xored together, which is two table
+// lookups instead of a trip though a loop for every bit. Called twice for every packet, so it adds up.
+
+static const uint8_t nibbleOddParity[16] PROGMEM = {
+    0x00 , 0x80 , 0x80 , 0x00 , 0x80 , 0x00 , 0x00 , 0x80 ,
+    0x80 , 0x00 , 0x00 , 0x80 , 0x00 , 0x80 , 0x80 , 0x00 ,
+};
+
+// Returns 0x80 if odd number of bits set, 0 otherwise
+
+static uint8_t oddParityBit( uint8_t d ) {
+
+    return pgm_read_byte( &nibbleOddParity[ d & 0x0f ] ) ^ pgm_read_byte( &nibbleOddParity[ d >> 4 ] );
 
-uint8_t oddParity( uint8_t d ) {
-    
-    uint8_t bits=0;
-    
-    while (d) {
-        
-        if (d & 0b00000001 ) {
-            bits++;
-        }
-        
-        d >>=1;
-        
-    }
-    
-    return bits & 0xb00000001;
 }
 
 static uint8_t irValueEncode( uint8_t d , uint8_t postponeSleepFlag ) {
@@ -119,20 +224,17 @@ static uint8_t irValueEncode( uint8_t d , uint8_t postponeSleepFlag ) {
         d |= 0b01000000;            // 6th bit button pressed flag
     }
     
-    if ( !oddParity( d )) {
-        
-        d |= 0b10000000;            // Top bit ODD parity (including postpone sleep flag)
-        
-    }
-    
-    return d;
+    // Top bit ODD parity (including postpone sleep flag). Since the top bit starts out 0, we set it
+    // exactly when the rest has an even number of bits set.
+
+    return d | ( oddParityBit( d ) ^ 0b10000000 );
     
 }
 
 
 static uint8_t irValueCheckValid( uint8_t d ) {
         
-    return oddParity( d );      // Odd parity
+    return oddParityBit( d );      // Odd parity
 
 }
 
@@ -159,6 +261,39 @@ static uint8_t irValueDecodePostponeSleepFlag( uint8_t d ) {
     #error IR_DATAGRAM_LEN must not be bigger than IR_RX_PACKET_SIZE
 #endif
 
+#if ( IR_DATAGRAM_LEN + DATAGRAM_PREFIX_LEN + 3 ) > IR_RX_PACKET_SIZE
+    #error There has to be enough room in the blinkos packet buffer to hold a datagram plus the header, link, value, and checksum bytes
+#endif
+
+// Fragments fill up the blinkos packet buffer after the BIOS type byte, header byte, (link byte), (value), fragment header byte, and checksum byte
+
+#ifdef BLINKLIB_FEC_DATAGRAMS
+    #define MESSAGE_FRAGMENT_LEN ( ( IR_RX_PACKET_SIZE - 2 ) / 2 - 2 - DATAGRAM_PREFIX_LEN )     // ...where everything after the header takes twice the room
+#else
+    #define MESSAGE_FRAGMENT_LEN ( IR_RX_PACKET_SIZE - 4 - DATAGRAM_PREFIX_LEN )
+#endif
+
+#if ( ( IR_MESSAGE_MAX_LEN + MESSAGE_FRAGMENT_LEN - 1 ) / MESSAGE_FRAGMENT_LEN ) > ( MESSAGE_FRAGMENT_INDEX_MASK + 1 )
+    #error IR_MESSAGE_MAX_LEN needs more fragments than fit in the fragment header
+#endif
+
+// Outgoing datagrams are kept as whole packets: header byte, (link byte), (value), payload, checksum byte
+
+#define OUT_DATAGRAM_PACKET_LEN ( IR_DATAGRAM_LEN + DATAGRAM_PREFIX_LEN + 2 )
+#define OUT_DATAGRAM_OFFSET     ( 1 + DATAGRAM_PREFIX_LEN )     // Where the payload starts
+
+// With BLINKLIB_FEC_DATAGRAMS, each byte after the header goes out as two
+
+#define FEC_DATAGRAM_PACKET_LEN ( 1 + 2 * ( OUT_DATAGRAM_PACKET_LEN - 1 ) )
+
+// The link byte and a wide value on every datagram, each doubled by FEC, is the one combination that does not fit (see blinklib.h)
+
+#if defined( BLINKLIB_FEC_DATAGRAMS ) && defined( BLINKLIB_RELIABLE_DATAGRAMS ) && defined( BLINKLIB_WIDE_VALUES ) && defined( BLINKLIB_DATAGRAM_VALUES )
+    #error BLINKLIB_FEC_DATAGRAMS, BLINKLIB_RELIABLE_DATAGRAMS, BLINKLIB_WIDE_VALUES, and BLINKLIB_DATAGRAM_VALUES can not all be on at once. A full datagram will not fit in the blinkos packet buffer. Leave out one of them.
+#elif defined( BLINKLIB_FEC_DATAGRAMS ) && FEC_DATAGRAM_PACKET_LEN > ( IR_RX_PACKET_SIZE - 1 )
+    #error There has to be enough room in the blinkos packet buffer to hold a datagram with forward error correction
+#endif
+
 // All semantics chosen to have sane startup 0 so we can
 // keep this in bss section and have it zeroed out at startup. 
 
@@ -166,18 +301,103 @@ struct face_t {
 
     uint8_t inValue;        // Last received value on this face, or 0 if no neighbor ever seen since startup
     uint8_t outValue;       // Value we send out on this face
+
+    #ifdef BLINKLIB_WIDE_VALUES
+        uint16_t inWideValue;   // Same, but all 16 bits. The low 6 bits are always also in inValue/outValue.
+        uint16_t outWideValue;
+    #endif
+
     millis_t expireTime;    // When this face will be considered to be expired (no neighbor there)
     millis_t sendTime;      // Next time we will transmit on this face (set to 0 every time we get a good message so we ping-pong across the link)
     
-    uint8_t inDatagramLen;  // 0= No datagram waiting to be read
-    uint8_t inDatagramData[IR_DATAGRAM_LEN];
+    // Received datagrams wait in a ring of IR_DATAGRAM_RX_SLOTS slots. A slot is full when its len is not 0.
+
+    uint8_t inDatagramLen[IR_DATAGRAM_RX_SLOTS];  // 0= No datagram waiting to be read in this slot
+
+    #ifndef BLINKLIB_ZERO_COPY_RX
+        uint8_t inDatagramData[IR_DATAGRAM_RX_SLOTS][IR_DATAGRAM_LEN];
+    #endif                                      // ...otherwise it stays in the BIOS packet buffer for this face
+
+    #if IR_DATAGRAM_RX_SLOTS > 1
+        uint8_t inDatagramHead; // Slot with the oldest datagram, which is what the user sees
+        uint8_t inDatagramTail; // Slot the next incoming datagram goes into
+    #endif
+
+    // Outgoing datagrams wait in a ring of IR_DATAGRAM_TX_SLOTS slots, same as incoming ones.
+
+    uint8_t outDatagramLen[IR_DATAGRAM_TX_SLOTS];  // 0= No datagram waiting to be sent in this slot
+    uint8_t outDatagramPacket[IR_DATAGRAM_TX_SLOTS][OUT_DATAGRAM_PACKET_LEN];    // Each is framed in place so TX_IRFaces() can send it as is
 
-    uint8_t outDatagramLen;  // 0= No datagram waiting to be sent
-    uint8_t outDatagramData[IR_DATAGRAM_LEN];
+    #if IR_DATAGRAM_TX_SLOTS > 1
+        uint8_t outDatagramHead; // Slot with the oldest datagram, which is the next to go out
+        uint8_t outDatagramTail; // Slot the next sendDatagramOnFace() goes into
+    #endif
+
+    #ifdef BLINKLIB_RELIABLE_DATAGRAMS
+        uint8_t linkState;      // LINK_STATE_* bits
+    #endif
+
+    #ifdef BLINKLIB_ADAPTIVE_PROBE
+        uint8_t probeBackoff;   // How many times we have doubled the probe time on this face since anyone was there
+    #endif
+
+    #ifdef BLINKLIB_MESSAGES
+        const uint8_t *outMessageData;  // Message being sent, or NULL if none
+        uint16_t outMessageLen;
+        uint8_t outMessageFragment;     // Index of the next fragment to go out
+
+        uint8_t *inMessageBuffer;       // Where incoming messages get put together, or NULL to not take them
+        uint16_t inMessageSize;
+        uint16_t inMessageLen;          // How much we have so far
+        uint8_t inMessageFragment;      // Index of the next fragment we expect, or MESSAGE_COMPLETE once we have the whole thing
+    #endif
 };
 
 static face_t faces[FACE_COUNT];
 
+static irEvents_t irEvents;         // See getIREvents()
+
+static irEvents_t irEventsPending;  // Events RX_IRFaces() has seen since run() last handed them to loop() in irEvents (datagramsReady is not used here)
+
+static uint8_t facesPresent;        // Bit for each face that has heard from a neighbor and not expired since. isAlone() and friends just look at this.
+
+static millis_t facesPresentCheckTime;  // No face in facesPresent can expire before this, so RX_IRFaces() does not need to look until then
+
+#define LINK_STATE_TX_SEQ       0b00000001      // Sequence bit of the datagram at the front of our send queue
+#define LINK_STATE_RX_SEQ       0b00000010      // Sequence bit of the next datagram we expect from the neighbor
+#define LINK_STATE_TX_BUSY      0b00000100      // We sent the thing at the front of the queue and are waiting for the ack
+#define LINK_STATE_TX_FRAGMENT  0b00001000      // ...and that thing is a message fragment rather than a datagram
+#define LINK_STATE_PEER_FULL    0b00010000      // The last packet from the neighbor said they did not have room for it
+#define LINK_STATE_EPOCH        0b00100000      // Our LINK_EPOCH_BIT
+#define LINK_STATE_PEER_EPOCH   0b01000000      // The LINK_EPOCH_BIT we last saw from the neighbor
+#define LINK_STATE_TX_BROADCAST 0b10000000      // ...or the broadcast datagram (see sendDatagramOnFaces)
+
+// Bits that survive starting the link over
+
+#define LINK_STATE_EPOCHS       ( LINK_STATE_EPOCH | LINK_STATE_PEER_EPOCH )
+
+#define MESSAGE_COMPLETE        0xff            // inMessageFragment once the whole message is in
+
+#ifdef BLINKLIB_LINK_STATS
+
+    static linkStats_t linkStats[FACE_COUNT];
+
+    #define LINK_STATS_COUNT( face , counter ) ( linkStats[ face ].counter++ )
+
+    const linkStats_t *getLinkStats( byte face ) {
+        return &linkStats[ face ];
+    }
+
+    void resetLinkStats( byte face ) {
+        memset( &linkStats[ face ] , 0 , sizeof( linkStats_t ) );
+    }
+
+#else
+
+    #define LINK_STATS_COUNT( face , counter )
+
+#endif
+
 uint8_t viralButtonPressSendOnFaceBitflags;   // A 1 here means send the viral button press bit on the next IR packet on this face. Cleared when it gets sent. 
 
 Timer viralButtonPressLockoutTimer;     // Set each time we send a viral button press to avoid sending getting into a circular loop
@@ -198,6 +418,77 @@ unsigned long millis() {
     return now;
 }
 
+#if defined( BLINKLIB_CRC8_NIBBLE_TABLE ) && !defined( BLINKLIB_CRC8_DATAGRAMS )
+    #error BLINKLIB_CRC8_NIBBLE_TABLE only makes sense with BLINKLIB_CRC8_DATAGRAMS
+#endif
+
+#ifdef BLINKLIB_CRC8_DATAGRAMS
+
+// CRC-8 with polynomial 0x07 (same as SMBus), but starting from 0xff so that a run of zero bytes does not
+// come out to a zero CRC.
+
+#define CRC8_INIT 0xff
+
+#ifdef BLINKLIB_CRC8_NIBBLE_TABLE
+
+// CRC of each nibble shifted though the top of the register. We do a byte as two nibbles. Twice the lookups of
+// the full table below, but 240 fewer bytes of flash.
+
+static const uint8_t crc8NibbleTable[16] PROGMEM = {
+    0x00 , 0x07 , 0x0e , 0x09 , 0x1c , 0x1b , 0x12 , 0x15 ,
+    0x38 , 0x3f , 0x36 , 0x31 , 0x24 , 0x23 , 0x2a , 0x2d ,
+};
+
+#else
+
+// CRC of each byte, so we can do a whole byte with one lookup
+
+static const uint8_t crc8Table[256] PROGMEM = {
+    0x00 , 0x07 , 0x0e , 0x09 , 0x1c , 0x1b , 0x12 , 0x15 , 0x38 , 0x3f , 0x36 , 0x31 , 0x24 , 0x23 , 0x2a , 0x2d ,
+    0x70 , 0x77 , 0x7e , 0x79 , 0x6c , 0x6b , 0x62 , 0x65 , 0x48 , 0x4f , 0x46 , 0x41 , 0x54 , 0x53 , 0x5a , 0x5d ,
+    0xe0 , 0xe7 , 0xee , 0xe9 , 0xfc , 0xfb , 0xf2 , 0xf5 , 0xd8 , 0xdf , 0xd6 , 0xd1 , 0xc4 , 0xc3 , 0xca , 0xcd ,
+    0x90 , 0x97 , 0x9e , 0x99 , 0x8c , 0x8b , 0x82 , 0x85 , 0xa8 , 0xaf , 0xa6 , 0xa1 , 0xb4 , 0xb3 , 0xba , 0xbd ,
+    0xc7 , 0xc0 , 0xc9 , 0xce , 0xdb , 0xdc , 0xd5 , 0xd2 , 0xff , 0xf8 , 0xf1 , 0xf6 , 0xe3 , 0xe4 , 0xed , 0xea ,
+    0xb7 , 0xb0 , 0xb9 , 0xbe , 0xab , 0xac , 0xa5 , 0xa2 , 0x8f , 0x88 , 0x81 , 0x86 , 0x93 , 0x94 , 0x9d , 0x9a ,
+    0x27 , 0x20 , 0x29 , 0x2e , 0x3b , 0x3c , 0x35 , 0x32 , 0x1f , 0x18 , 0x11 , 0x16 , 0x03 , 0x04 , 0x0d , 0x0a ,
+    0x57 , 0x50 , 0x59 , 0x5e , 0x4b , 0x4c , 0x45 , 0x42 , 0x6f , 0x68 , 0x61 , 0x66 , 0x73 , 0x74 , 0x7d , 0x7a ,
+    0x89 , 0x8e , 0x87 , 0x80 , 0x95 , 0x92 , 0x9b , 0x9c , 0xb1 , 0xb6 , 0xbf , 0xb8 , 0xad , 0xaa , 0xa3 , 0xa4 ,
+    0xf9 , 0xfe , 0xf7 , 0xf0 , 0xe5 , 0xe2 , 0xeb , 0xec , 0xc1 , 0xc6 , 0xcf , 0xc8 , 0xdd , 0xda , 0xd3 , 0xd4 ,
+    0x69 , 0x6e , 0x67 , 0x60 , 0x75 , 0x72 , 0x7b , 0x7c , 0x51 , 0x56 , 0x5f , 0x58 , 0x4d , 0x4a , 0x43 , 0x44 ,
+    0x19 , 0x1e , 0x17 , 0x10 , 0x05 , 0x02 , 0x0b , 0x0c , 0x21 , 0x26 , 0x2f , 0x28 , 0x3d , 0x3a , 0x33 , 0x34 ,
+    0x4e , 0x49 , 0x40 , 0x47 , 0x52 , 0x55 , 0x5c , 0x5b , 0x76 , 0x71 , 0x78 , 0x7f , 0x6a , 0x6d , 0x64 , 0x63 ,
+    0x3e , 0x39 , 0x30 , 0x37 , 0x22 , 0x25 , 0x2c , 0x2b , 0x06 , 0x01 , 0x08 , 0x0f , 0x1a , 0x1d , 0x14 , 0x13 ,
+    0xae , 0xa9 , 0xa0 , 0xa7 , 0xb2 , 0xb5 , 0xbc , 0xbb , 0x96 , 0x91 , 0x98 , 0x9f , 0x8a , 0x8d , 0x84 , 0x83 ,
+    0xde , 0xd9 , 0xd0 , 0xd7 , 0xc2 , 0xc5 , 0xcc , 0xcb , 0xe6 , 0xe1 , 0xe8 , 0xef , 0xfa , 0xfd , 0xf4 , 0xf3 ,
+};
+
+#endif
+
+// Returns the CRC-8 of all bytes
+
+uint8_t computePacketChecksum( volatile const uint8_t *buffer , uint8_t len ) {
+
+    uint8_t crc = CRC8_INIT;
+
+    for( uint8_t l=0; l < len ; l++ ) {
+
+        crc ^= *buffer++;
+
+        #ifdef BLINKLIB_CRC8_NIBBLE_TABLE
+            crc = ( crc << 4 ) ^ pgm_read_byte( &crc8NibbleTable[ crc >> 4 ] );
+            crc = ( crc << 4 ) ^ pgm_read_byte( &crc8NibbleTable[ crc >> 4 ] );
+        #else
+            crc = pgm_read_byte( &crc8Table[ crc ] );
+        #endif
+
+    }
+
+    return crc;
+
+}
+
+#else
+
 // Returns the inverted checksum of all bytes
 
 uint8_t computePacketChecksum( volatile const uint8_t *buffer , uint8_t len ) {
@@ -214,6 +505,102 @@ uint8_t computePacketChecksum( volatile const uint8_t *buffer , uint8_t len ) {
 
 }
 
+#endif
+
+
+#ifdef BLINKLIB_FEC_DATAGRAMS
+
+// Forward error correction. Each nibble after the header byte goes out as an extended Hamming(8,4) code byte,
+// so the other side can fix any one flipped bit in each code byte (and notice any two) before the checksum
+// ever sees it. Bit 0 is parity over the whole code byte, bits 1, 2, and 4 are the Hamming parity bits, and
+// the nibble is in bits 3, 5, 6, and 7.
+
+static const uint8_t fecEncodeTable[16] PROGMEM = {
+    0x00 , 0x0f , 0x33 , 0x3c , 0x55 , 0x5a , 0x66 , 0x69 ,
+    0x96 , 0x99 , 0xa5 , 0xaa , 0xc3 , 0xcc , 0xf0 , 0xff ,
+};
+
+// What each code byte we might get decodes to. The nibble is in the low bits, with FEC_CORRECTED set if we had to
+// fix a bit to get it, or just FEC_UNCORRECTABLE if two bits were flipped.
+
+#define FEC_CORRECTED       0x10
+#define FEC_UNCORRECTABLE   0x80
+
+static const uint8_t fecDecodeTable[256] PROGMEM = {
+    0x00 , 0x10 , 0x10 , 0x80 , 0x10 , 0x80 , 0x80 , 0x11 , 0x10 , 0x80 , 0x80 , 0x11 , 0x80 , 0x11 , 0x11 , 0x01 ,
+    0x10 , 0x80 , 0x80 , 0x12 , 0x80 , 0x14 , 0x18 , 0x80 , 0x80 , 0x19 , 0x15 , 0x80 , 0x13 , 0x80 , 0x80 , 0x11 ,
+    0x10 , 0x80 , 0x80 , 0x12 , 0x80 , 0x1a , 0x16 , 0x80 , 0x80 , 0x17 , 0x1b , 0x80 , 0x13 , 0x80 , 0x80 , 0x11 ,
+    0x80 , 0x12 , 0x12 , 0x02 , 0x13 , 0x80 , 0x80 , 0x12 , 0x13 , 0x80 , 0x80 , 0x12 , 0x03 , 0x13 , 0x13 , 0x80 ,
+    0x10 , 0x80 , 0x80 , 0x1c , 0x80 , 0x14 , 0x16 , 0x80 , 0x80 , 0x17 , 0x15 , 0x80 , 0x1d , 0x80 , 0x80 , 0x11 ,
+    0x80 , 0x14 , 0x15 , 0x80 , 0x14 , 0x04 , 0x80 , 0x14 , 0x15 , 0x80 , 0x05 , 0x15 , 0x80 , 0x14 , 0x15 , 0x80 ,
+    0x80 , 0x17 , 0x16 , 0x80 , 0x16 , 0x80 , 0x06 , 0x16 , 0x17 , 0x07 , 0x80 , 0x17 , 0x80 , 0x17 , 0x16 , 0x80 ,
+    0x1e , 0x80 , 0x80 , 0x12 , 0x80 , 0x14 , 0x16 , 0x80 , 0x80 , 0x17 , 0x15 , 0x80 , 0x13 , 0x80 , 0x80 , 0x1f ,
+    0x10 , 0x80 , 0x80 , 0x1c , 0x80 , 0x1a , 0x18 , 0x80 , 0x80 , 0x19 , 0x1b , 0x80 , 0x1d , 0x80 , 0x80 , 0x11 ,
+    0x80 , 0x19 , 0x18 , 0x80 , 0x18 , 0x80 , 0x08 , 0x18 , 0x19 , 0x09 , 0x80 , 0x19 , 0x80 , 0x19 , 0x18 , 0x80 ,
+    0x80 , 0x1a , 0x1b , 0x80 , 0x1a , 0x0a , 0x80 , 0x1a , 0x1b , 0x80 , 0x0b , 0x1b , 0x80 , 0x1a , 0x1b , 0x80 ,
+    0x1e , 0x80 , 0x80 , 0x12 , 0x80 , 0x1a , 0x18 , 0x80 , 0x80 , 0x19 , 0x1b , 0x80 , 0x13 , 0x80 , 0x80 , 0x1f ,
+    0x80 , 0x1c , 0x1c , 0x0c , 0x1d , 0x80 , 0x80 , 0x1c , 0x1d , 0x80 , 0x80 , 0x1c , 0x0d , 0x1d , 0x1d , 0x80 ,
+    0x1e , 0x80 , 0x80 , 0x1c , 0x80 , 0x14 , 0x18 , 0x80 , 0x80 , 0x19 , 0x15 , 0x80 , 0x1d , 0x80 , 0x80 , 0x1f ,
+    0x1e , 0x80 , 0x80 , 0x1c , 0x80 , 0x1a , 0x16 , 0x80 , 0x80 , 0x17 , 0x1b , 0x80 , 0x1d , 0x80 , 0x80 , 0x1f ,
+    0x0e , 0x1e , 0x1e , 0x80 , 0x1e , 0x80 , 0x80 , 0x1f , 0x1e , 0x80 , 0x80 , 0x1f , 0x80 , 0x1f , 0x1f , 0x0f ,
+};
+
+// Spread len bytes out into twice as many code bytes, low nibble first. Works from the end back so that
+// dest can be the same as src. Returns the new length.
+
+static uint8_t fecEncode( uint8_t *dest , const uint8_t *src , uint8_t len ) {
+
+    uint8_t i = len;
+
+    while ( i-- ) {
+
+        uint8_t b = src[i];
+
+        dest[ 2 * i + 1 ] = pgm_read_byte( &fecEncodeTable[ b >> 4 ] );
+        dest[ 2 * i     ] = pgm_read_byte( &fecEncodeTable[ b & 0x0f ] );
+
+    }
+
+    return 2 * len;
+
+}
+
+// Put len code bytes back together into len/2 bytes right where they are, fixing any single flipped bits as we go.
+// Returns false if the length is wrong or there was a code byte we could not fix.
+
+static boolean fecDecode( uint8_t face , uint8_t *data , uint8_t len ) {
+
+    if ( len & 1 ) {
+        return false;
+    }
+
+    const uint8_t *code = data;
+
+    for( uint8_t i = 0 ; i < len / 2 ; i++ ) {
+
+        uint8_t lo = pgm_read_byte( &fecDecodeTable[ *code++ ] );
+        uint8_t hi = pgm_read_byte( &fecDecodeTable[ *code++ ] );
+
+        if ( ( lo | hi ) & FEC_UNCORRECTABLE ) {
+            return false;
+        }
+
+        #ifdef BLINKLIB_LINK_STATS
+            if ( lo & FEC_CORRECTED ) LINK_STATS_COUNT( face , bitsCorrected );
+            if ( hi & FEC_CORRECTED ) LINK_STATS_COUNT( face , bitsCorrected );
+        #else
+            (void) face;
+        #endif
+
+        data[i] = ( lo & 0x0f ) | ( hi << 4 );
+
+    }
+
+    return true;
+
+}
+
+#endif
 
 #if  ( ( IR_LONG_PACKET_MAX_LEN + 3  ) > IR_RX_PACKET_SIZE )
 
@@ -221,8 +608,60 @@ uint8_t computePacketChecksum( volatile const uint8_t *buffer , uint8_t len ) {
 
 #endif
 
+#if IR_DATAGRAM_RX_SLOTS < 1 || IR_DATAGRAM_TX_SLOTS < 1
+    #error IR_DATAGRAM_RX_SLOTS and IR_DATAGRAM_TX_SLOTS must be at least 1
+#endif
+
+#if defined( BLINKLIB_ZERO_COPY_RX ) && IR_DATAGRAM_RX_SLOTS > 1
+    #error BLINKLIB_ZERO_COPY_RX only has the one BIOS packet buffer per face, so it can not have more IR_DATAGRAM_RX_SLOTS
+#endif
+
+// With BLINKLIB_ZERO_COPY_RX, we hang onto the BIOS packet buffer while there is a datagram in it for the user
+
+#ifdef BLINKLIB_ZERO_COPY_RX
+    #define IN_DATAGRAM_HELD( f ) ( (f)->inDatagramLen[0] )
+#else
+    #define IN_DATAGRAM_HELD( f ) 0
+#endif
+
+// Where the datagram payload starts in the BIOS packet buffer. Skip the BIOS type byte, header byte, and link and value bytes if any.
+
+#define IN_DATAGRAM_OFFSET ( 2 + DATAGRAM_PREFIX_LEN )
+
+// Move a ring index on to the next of `slots` slots (only needed if either ring has more than one)
+
+#if IR_DATAGRAM_RX_SLOTS > 1 || IR_DATAGRAM_TX_SLOTS > 1
+
+static uint8_t nextDatagramSlot( uint8_t slot , uint8_t slots ) {
+
+    if ( ++slot == slots ) {
+        slot = 0;
+    }
+
+    return slot;
+}
+
+#endif
+
+#if IR_DATAGRAM_RX_SLOTS > 1
+    #define IN_DATAGRAM_HEAD( f ) ( (f)->inDatagramHead )
+    #define IN_DATAGRAM_TAIL( f ) ( (f)->inDatagramTail )
+#else
+    // With only one slot, it is always slot 0 and we can save the RAM
+    #define IN_DATAGRAM_HEAD( f ) 0
+    #define IN_DATAGRAM_TAIL( f ) 0
+#endif
+
+#if IR_DATAGRAM_TX_SLOTS > 1
+    #define OUT_DATAGRAM_HEAD( f ) ( (f)->outDatagramHead )
+    #define OUT_DATAGRAM_TAIL( f ) ( (f)->outDatagramTail )
+#else
+    #define OUT_DATAGRAM_HEAD( f ) 0
+    #define OUT_DATAGRAM_TAIL( f ) 0
+#endif
+
 byte getDatagramLengthOnFace( uint8_t face ) {    
-    return faces[face].inDatagramLen;
+    return faces[face].inDatagramLen[ IN_DATAGRAM_HEAD( &faces[face] ) ];
 }
 
 boolean isDatagramReadyOnFace( uint8_t face ) {
@@ -230,11 +669,42 @@ boolean isDatagramReadyOnFace( uint8_t face ) {
 }
 
 const byte *getDatagramOnFace( uint8_t face ) {
-    return faces[face].inDatagramData;
+
+    #ifdef BLINKLIB_ZERO_COPY_RX
+        // Safe to drop the volatile since the BIOS will not touch the buffer until we clear packetBufferReady
+        return (const byte *) blinkbios_irdata_block.ir_rx_states[face].packetBuffer + IN_DATAGRAM_OFFSET;
+    #else
+        return faces[face].inDatagramData[ IN_DATAGRAM_HEAD( &faces[face] ) ];
+    #endif
+
 }
 
 void markDatagramReadOnFace( uint8_t face ) {
-    faces[face].inDatagramLen = 0;
+
+    face_t *f = &faces[face];
+
+    if ( f->inDatagramLen[ IN_DATAGRAM_HEAD( f ) ] ) {
+
+        f->inDatagramLen[ IN_DATAGRAM_HEAD( f ) ] = 0;
+
+        #ifdef BLINKLIB_ZERO_COPY_RX
+            blinkbios_irdata_block.ir_rx_states[face].packetBufferReady = 0;      // Done with it, so the BIOS can have it back
+        #endif
+
+        #if IR_DATAGRAM_RX_SLOTS > 1
+            f->inDatagramHead = nextDatagramSlot( f->inDatagramHead , IR_DATAGRAM_RX_SLOTS );
+        #endif
+
+        if ( !f->inDatagramLen[ IN_DATAGRAM_HEAD( f ) ] ) {
+            irEvents.datagramsReady &= ~( 1 << face );        // That was the last one waiting
+        }
+
+        #ifdef BLINKLIB_RELIABLE_DATAGRAMS
+            f->sendTime = 0;        // Let the neighbor know right away that we have room now
+        #endif
+
+    }
+
 }    
 
 // Jump to the send packet function all way up in the bootloader
@@ -251,78 +721,488 @@ uint8_t blinkbios_irdata_send_packet(  uint8_t face, const uint8_t *data , uint8
 #define CBI(x,b) (x&=~(1<<b))           // Clear bit
 #define TBI(x,b) (x&(1<<b))             // Test bit
 
-void sendDatagramOnFace( const void *data, byte len , byte face ) {
+// Something new to send on this face. If the neighbor does not answer our next packet (because one of them got lost),
+// send it again in TX_PROBE_BUSY_MS rather than a whole TX_PROBE_TIME_MS. Unless nobody is there, then why bother.
 
-    if ( len > IR_DATAGRAM_LEN ) {
+static void probeSoon( face_t *face ) {
 
-        // Ignore request to send oversized packet
+    #ifdef BLINKLIB_ADAPTIVE_PROBE
 
-        return;
+        millis_t soon = now + TX_PROBE_BUSY_MS;
+
+        if ( !face->probeBackoff && face->sendTime > soon ) {
+            face->sendTime = soon;
+        }
+
+    #else
+
+        (void) face;
+
+    #endif
 
-    }
-    
-    face_t *f = &faces[face];
-    
-    f->outDatagramLen = len;
-    memcpy( f->outDatagramData , data , len ); 
-    
 }
 
+byte *beginDatagramOnFace( byte face ) {
 
-static void clear_packet_buffers() {
+    face_t *f = &faces[face];
 
-    FOREACH_FACE(f) {
+    uint8_t slot = OUT_DATAGRAM_TAIL( f );
 
-        blinkbios_irdata_block.ir_rx_states[f].packetBufferReady = 0;
+    if ( f->outDatagramLen[ slot ] ) {
+
+        LINK_STATS_COUNT( face , datagramsOverwritten );
+
+        #if IR_DATAGRAM_TX_SLOTS > 1 || defined( BLINKLIB_RELIABLE_DATAGRAMS )
+
+            // Queue is full. Let the caller know so they can try again later.
+            // (Reliable mode can not replace a datagram that might already be on its way)
+
+            return NULL;
+
+        #endif
+
+        // Only one slot, so the new datagram replaces the pending one like it always has.
+        // Toss the pending one now so that if they never commit, we do not send a half written one.
+
+        f->outDatagramLen[ slot ] = 0;
 
     }
-}
 
-// Set the color and display it immediately
-// for internal use where we do not want the loop buffering
+    return f->outDatagramPacket[ slot ] + OUT_DATAGRAM_OFFSET;
 
-static void setColorNow( Color newColor ) {
-    
-    setColor( newColor );
-    BLINKBIOS_DISPLAY_PIXEL_BUFFER_VECTOR();
-        
 }
 
+boolean commitDatagramOnFace( byte face , byte len ) {
 
-Color dim( Color color, byte brightness) {
-    return MAKECOLOR_5BIT_RGB(
-    (GET_5BIT_R(color)*brightness)/255,
-    (GET_5BIT_G(color)*brightness)/255,
-    (GET_5BIT_B(color)*brightness)/255
-    );
-}
+    if ( len > IR_DATAGRAM_LEN || len == 0 ) {
 
+        // Ignore request to send oversized (or empty) packet
 
-// When will we warm sleep due to inactivity
-// reset by a button press or seeing a button press bit on
-// an incoming packet
+        return false;
 
-Timer warm_sleep_time;
+    }
 
-void reset_warm_sleep_timer() {
+    face_t *f = &faces[face];
 
-    warm_sleep_time.set( WARM_SLEEP_TIMEOUT_MS );
+    uint8_t slot = OUT_DATAGRAM_TAIL( f );
 
-}
+    if ( f->outDatagramLen[ slot ] ) {
 
-// Remembers if we have woken from either a BIOS sleep or
-// a blinklib forced sleep.
+        // Same test as beginDatagramOnFace(). This slot still has a datagram waiting to go out (or waiting to be
+        // acked), so either beginDatagramOnFace() turned this one away or it was never called. Framing over
+        // it would mangle that one while it might still be on its way.
 
-uint8_t hasWarmWokenFlag =0;
+        return false;
 
-// We need to save the pixel buffer when we warm sleep so we display our 
-// sleep and wake animations and then restore the original game pixels before restarting the game
+    }
 
-pixelColor_t savedPixelBuffer[PIXEL_COUNT];
+    uint8_t *packet = f->outDatagramPacket[ slot ];
 
-void savePixels() {
-   // Save game pixels
-   
+    #ifdef BLINKLIB_RELIABLE_DATAGRAMS
+        packet[1] = 0;      // The real link byte gets added into the checksum when it goes out (see TX_IRFaces)
+    #endif
+
+    // The checksum covers everything after the header byte, which TX_IRFaces() fills in when it goes out
+
+    packet[ OUT_DATAGRAM_OFFSET + len ] = computePacketChecksum( packet + 1 , DATAGRAM_PREFIX_LEN + len );
+
+    f->outDatagramLen[ slot ] = len;
+
+    #if IR_DATAGRAM_TX_SLOTS > 1
+        f->outDatagramTail = nextDatagramSlot( slot , IR_DATAGRAM_TX_SLOTS );
+    #endif
+
+    probeSoon( f );
+
+    return true;
+
+}
+
+boolean sendDatagramOnFace( const void *data, byte len , byte face ) {
+
+    if ( len > IR_DATAGRAM_LEN ) {
+
+        // Ignore request to send oversized packet
+
+        return false;
+
+    }
+    
+    byte *d = beginDatagramOnFace( face );
+
+    if ( !d ) {
+        return false;
+    }
+
+    memcpy( d , data , len ); 
+
+    return commitDatagramOnFace( face , len );
+    
+}
+
+// Drop the datagram at the front of the send queue, either because it went out or because the other side acknowledged it
+
+static void popOutDatagram( face_t *face ) {
+
+    uint8_t slot = OUT_DATAGRAM_HEAD( face );
+
+    if ( face->outDatagramLen[ slot ] ) {
+
+        face->outDatagramLen[ slot ] = 0;
+
+        #if IR_DATAGRAM_TX_SLOTS > 1
+            face->outDatagramHead = nextDatagramSlot( slot , IR_DATAGRAM_TX_SLOTS );
+        #endif
+
+    }
+
+}
+
+#ifdef BLINKLIB_BROADCAST_DATAGRAMS
+
+// One copy of the broadcast datagram, framed the same way as the ones in outDatagramPacket. Each face
+// fills in its own header (and link byte) right before it goes out, so they can all share it.
+
+static uint8_t broadcastPacket[ OUT_DATAGRAM_PACKET_LEN ];
+static uint8_t broadcastLen;
+static uint8_t broadcastFaces;          // Bit for each face that it still has to go out on (or in reliable mode, be acked on)
+
+boolean sendDatagramOnFaces( const void *data , byte len , byte faceMask ) {
+
+    faceMask &= IR_FACE_BITMASK;
+
+    if ( len > IR_DATAGRAM_LEN || len == 0 || faceMask == 0 ) {
+
+        // Ignore request to send oversized (or empty) packet, or to send it nowhere
+
+        return false;
+
+    }
+
+    if ( broadcastFaces ) {
+
+        #ifdef BLINKLIB_LINK_STATS
+            FOREACH_FACE(f) {
+                if ( TBI( broadcastFaces , f ) ) {
+                    LINK_STATS_COUNT( f , datagramsOverwritten );
+                }
+            }
+        #endif
+
+        #if IR_DATAGRAM_TX_SLOTS > 1 || defined( BLINKLIB_RELIABLE_DATAGRAMS )
+
+            // Still going out on some faces. Same rule as sendDatagramOnFace().
+
+            return false;
+
+        #endif
+
+        // Only one slot, so the new one replaces it on any faces it has not gone out on yet
+
+    }
+
+    memcpy( broadcastPacket + OUT_DATAGRAM_OFFSET , data , len );
+
+    #ifdef BLINKLIB_RELIABLE_DATAGRAMS
+        broadcastPacket[1] = 0;      // Each face adds its own link byte into the checksum when it goes out
+    #endif
+
+    broadcastPacket[ OUT_DATAGRAM_OFFSET + len ] = computePacketChecksum( broadcastPacket + 1 , DATAGRAM_PREFIX_LEN + len );
+
+    broadcastLen = len;
+    broadcastFaces = faceMask;
+
+    FOREACH_FACE(f) {
+        if ( TBI( broadcastFaces , f ) ) {
+            probeSoon( &faces[f] );
+        }
+    }
+
+    return true;
+
+}
+
+byte getDatagramFacesPending() {
+    return broadcastFaces;
+}
+
+#endif
+
+#ifdef BLINKLIB_MESSAGES
+
+boolean sendMessageOnFace( const void *data , word len , byte face ) {
+
+    face_t *f = &faces[face];
+
+    if ( f->outMessageData || len == 0 || len > IR_MESSAGE_MAX_LEN ) {
+        return false;
+    }
+
+    f->outMessageData = (const uint8_t *) data;
+    f->outMessageLen = len;
+    f->outMessageFragment = 0;
+
+    probeSoon( f );
+
+    return true;
+
+}
+
+boolean isMessageSendingOnFace( byte face ) {
+    return faces[face].outMessageData != NULL;
+}
+
+void setMessageBufferOnFace( byte face , void *buffer , word size ) {
+
+    face_t *f = &faces[face];
+
+    f->inMessageBuffer = (uint8_t *) buffer;
+    f->inMessageSize = size;
+    f->inMessageLen = 0;
+    f->inMessageFragment = 0;
+
+}
+
+boolean isMessageReadyOnFace( byte face ) {
+    return faces[face].inMessageFragment == MESSAGE_COMPLETE;
+}
+
+word getMessageLengthOnFace( byte face ) {
+    return isMessageReadyOnFace( face ) ? faces[face].inMessageLen : 0;
+}
+
+void markMessageReadOnFace( byte face ) {
+
+    faces[face].inMessageLen = 0;
+    faces[face].inMessageFragment = 0;
+
+    #ifdef BLINKLIB_RELIABLE_DATAGRAMS
+        faces[face].sendTime = 0;        // Let the neighbor know right away that we have room now
+    #endif
+
+}
+
+// Put a fragment (starting with its fragment header byte) into the message buffer for this face.
+// Returns false if we can not take it right now because there is no buffer or the last message has not been read.
+
+static boolean receiveMessageFragment( face_t *face , const uint8_t *data , uint8_t len ) {
+
+    if ( !face->inMessageBuffer || face->inMessageFragment == MESSAGE_COMPLETE ) {
+        return false;
+    }
+
+    uint8_t header = *data++;
+    len--;
+
+    uint8_t index = header & MESSAGE_FRAGMENT_INDEX_MASK;
+
+    if ( index == 0 ) {
+
+        // Start of a new message. Throws out anything left over from one that never finished.
+
+        face->inMessageLen = 0;
+        face->inMessageFragment = 0;
+
+    }
+
+    if ( index != face->inMessageFragment || face->inMessageLen + len > face->inMessageSize ) {
+
+        // We missed a fragment or the message will not fit. Toss it and wait for the start of the next one.
+
+        face->inMessageLen = 0;
+        face->inMessageFragment = 0;
+
+        return true;
+
+    }
+
+    memcpy( face->inMessageBuffer + face->inMessageLen , data , len );
+
+    face->inMessageLen += len;
+
+    if ( header & MESSAGE_FRAGMENT_LAST_BIT ) {
+        face->inMessageFragment = MESSAGE_COMPLETE;
+    } else {
+        face->inMessageFragment++;
+    }
+
+    return true;
+
+}
+
+#endif
+
+// What goes out the next time we send on a face
+
+#define OUTGOING_VALUE          0
+#define OUTGOING_DATAGRAM       1
+#define OUTGOING_FRAGMENT       2
+#define OUTGOING_BROADCAST      3
+
+static uint8_t nextOutgoing( const face_t *face ) {
+
+    #ifdef BLINKLIB_RELIABLE_DATAGRAMS
+
+        // Whatever is waiting on an ack has to keep going out until it gets one, even if a datagram
+        // got queued in front of a message in the meantime, or else the sequence bits would not line up
+
+        if ( face->linkState & LINK_STATE_TX_BUSY ) {
+
+            if ( face->linkState & LINK_STATE_TX_FRAGMENT ) {
+                return OUTGOING_FRAGMENT;
+            }
+
+            #ifdef BLINKLIB_BROADCAST_DATAGRAMS
+                if ( face->linkState & LINK_STATE_TX_BROADCAST ) {
+                    return OUTGOING_BROADCAST;
+                }
+            #endif
+
+            return OUTGOING_DATAGRAM;
+
+        }
+
+    #endif
+
+    if ( face->outDatagramLen[ OUT_DATAGRAM_HEAD( face ) ] ) {
+        return OUTGOING_DATAGRAM;
+    }
+
+    #ifdef BLINKLIB_BROADCAST_DATAGRAMS
+
+        // A broadcast waits behind any datagrams that were already queued on this face
+
+        uint8_t f = face - faces;
+
+        if ( TBI( broadcastFaces , f ) ) {
+            return OUTGOING_BROADCAST;
+        }
+
+    #endif
+
+    #ifdef BLINKLIB_MESSAGES
+
+        if ( face->outMessageData ) {
+            return OUTGOING_FRAGMENT;
+        }
+
+    #endif
+
+    return OUTGOING_VALUE;
+
+}
+
+// The datagram or fragment we sent is done (sent, or in reliable mode, acked) so move on to the next one
+
+static void outgoingDone( face_t *face , uint8_t outgoing ) {
+
+    if ( outgoing == OUTGOING_DATAGRAM ) {
+
+        popOutDatagram( face );
+
+    }
+
+    #ifdef BLINKLIB_BROADCAST_DATAGRAMS
+
+        if ( outgoing == OUTGOING_BROADCAST ) {
+            uint8_t f = face - faces;
+            CBI( broadcastFaces , f );
+        }
+
+    #endif
+
+    #ifdef BLINKLIB_MESSAGES
+
+        if ( outgoing == OUTGOING_FRAGMENT ) {
+
+            if ( ( face->outMessageFragment + 1 ) * (uint16_t) MESSAGE_FRAGMENT_LEN >= face->outMessageLen ) {
+                face->outMessageData = NULL;         // That was the last one
+            } else {
+                face->outMessageFragment++;
+            }
+
+        }
+
+    #endif
+
+}
+
+byte getDatagramSlotsFreeOnFace( byte face ) {
+
+    byte count = 0;
+
+    for( uint8_t slot = 0 ; slot < IR_DATAGRAM_TX_SLOTS ; slot++ ) {
+
+        if ( faces[face].outDatagramLen[ slot ] == 0 ) {
+            count++;
+        }
+
+    }
+
+    return count;
+
+}
+
+
+static void clear_packet_buffers() {
+
+    FOREACH_FACE(f) {
+
+        blinkbios_irdata_block.ir_rx_states[f].packetBufferReady = 0;
+
+        #ifdef BLINKLIB_ZERO_COPY_RX
+            faces[f].inDatagramLen[0] = 0;      // Any datagram we were holding in there is gone now
+            CBI( irEvents.datagramsReady , f );
+        #endif
+
+    }
+}
+
+// Set the color and display it immediately
+// for internal use where we do not want the loop buffering
+
+static void setColorNow( Color newColor ) {
+    
+    setColor( newColor );
+    BLINKBIOS_DISPLAY_PIXEL_BUFFER_VECTOR();
+        
+}
+
+
+Color dim( Color color, byte brightness) {
+    return MAKECOLOR_5BIT_RGB(
+    (GET_5BIT_R(color)*brightness)/255,
+    (GET_5BIT_G(color)*brightness)/255,
+    (GET_5BIT_B(color)*brightness)/255
+    );
+}
+
+
+// When will we warm sleep due to inactivity
+// reset by a button press or seeing a button press bit on
+// an incoming packet
+
+Timer warm_sleep_time;
+
+void reset_warm_sleep_timer() {
+
+    warm_sleep_time.set( WARM_SLEEP_TIMEOUT_MS );
+
+}
+
+// Remembers if we have woken from either a BIOS sleep or
+// a blinklib forced sleep.
+
+uint8_t hasWarmWokenFlag =0;
+
+// We need to save the pixel buffer when we warm sleep so we display our 
+// sleep and wake animations and then restore the original game pixels before restarting the game
+
+pixelColor_t savedPixelBuffer[PIXEL_COUNT];
+
+void savePixels() {
+   // Save game pixels
+   
    FOREACH_FACE(f) {
        
        savedPixelBuffer[f] = blinkbios_pixel_block.pixelBuffer[f];
@@ -447,6 +1327,8 @@ static void warm_sleep_cycle() {
         //       2. Adding a new_pack_recieved_flag to ir_block so we only scan when there is a new packet
         // UPDATE: Tried all that and it only saved like 0.1-0.2mA and added dozens of bytes of code so not worth it.
 
+        BLINKBIOS_SPIN_YIELD();
+
 
         ir_rx_state_t *ir_rx_state = blinkbios_irdata_block.ir_rx_states;
 
@@ -533,22 +1415,203 @@ void viralPostponeWarmSleep() {
         
 }
 
-static void RX_IRFaces() {
+#ifdef BLINKLIB_RELIABLE_DATAGRAMS
 
-    //  Use these pointers to step though the arrays
-    face_t *face = faces;
-    volatile ir_rx_state_t *ir_rx_state = blinkbios_irdata_block.ir_rx_states;
+// The link byte we send on this face, with the sequence bit of the datagram at the front of our queue
+// and the sequence bit of the last datagram we took from the neighbor
 
-    for( uint8_t f=0; f < FACE_COUNT ; f++ ) {
+static uint8_t reliableLinkByte( const face_t *face ) {
 
-            // Check for anything new coming in...
+    uint8_t b = 0;
 
-        if ( ir_rx_state->packetBufferReady ) {
+    if ( face->linkState & LINK_STATE_TX_SEQ ) {
+        b |= LINK_SEQ_BIT;
+    }
+
+    if ( !( face->linkState & LINK_STATE_RX_SEQ ) ) {       // Last one we took is the one before the one we expect next
+        b |= LINK_ACK_BIT;
+    }
+
+    boolean ready = face->inDatagramLen[ IN_DATAGRAM_TAIL( face ) ] == 0;
+
+    #ifdef BLINKLIB_MESSAGES
+        ready = ready || ( face->inMessageBuffer && face->inMessageFragment != MESSAGE_COMPLETE );
+    #endif
+
+    if ( ready ) {
+        b |= LINK_READY_BIT;
+    }
+
+    if ( face->linkState & LINK_STATE_EPOCH ) {
+        b |= LINK_EPOCH_BIT;
+    }
+
+    return LINK_BYTE_ENCODE( b );
+
+}
+
+// Start the sequence over on this face. Anything we were sending goes again from the top.
+
+static void reliableLinkReset( face_t *face ) {
+
+    face->linkState &= LINK_STATE_EPOCHS;
+
+    #ifdef BLINKLIB_MESSAGES
+        face->outMessageFragment = 0;       // Any message we were in the middle of starts over too
+    #endif
+
+}
+
+// Every link byte from the neighbor comes though here before we look at what else is in the packet.
+//
+// If their epoch bit changed then they started their side of the link over, so we do the same to match. Packets
+// on a face arrive in order, so everything after that first one with the new epoch is from the new sequence.
+//
+// Then they are acknowledging the last datagram (or fragment) they took from us. If that is the one we are waiting
+// on then it is delivered and we can move on to the next one.
+//
+// Returns true if we should send right away. That is not the case when a packet crossed the datagram we have in
+// flight on the way over (or they had no room for it). Sending it again right then would just keep two packets bouncing
+// back and forth with every other one a repeat, so instead we wait for the ack and only send again if none shows up by
+// the probe time, or the neighbor tells us they just made room.
+
+static boolean reliableLinkReceive( face_t *face , uint8_t linkByte ) {
+
+    if ( ( ( linkByte & LINK_EPOCH_BIT ) ? 1 : 0 ) != ( ( face->linkState & LINK_STATE_PEER_EPOCH ) ? 1 : 0 ) ) {
+
+        reliableLinkReset( face );
+
+        face->linkState ^= LINK_STATE_PEER_EPOCH;
+
+    }
+
+    boolean ackSeq = ( linkByte & LINK_ACK_BIT ) ? 1 : 0;
+    boolean txSeq  = ( face->linkState & LINK_STATE_TX_SEQ ) ? 1 : 0;
+
+    boolean sendNow = !( face->linkState & LINK_STATE_TX_BUSY );
+
+    if ( ackSeq == txSeq && !sendNow ) {
+
+        outgoingDone( face , nextOutgoing( face ) );
+
+        face->linkState ^= LINK_STATE_TX_SEQ;
+        face->linkState &= ~( LINK_STATE_TX_BUSY | LINK_STATE_TX_FRAGMENT | LINK_STATE_TX_BROADCAST );
+
+        sendNow = true;
+
+    }
+
+    if ( linkByte & LINK_READY_BIT ) {
+
+        if ( face->linkState & LINK_STATE_PEER_FULL ) {
+            sendNow = true;
+        }
+
+        face->linkState &= ~LINK_STATE_PEER_FULL;
+
+    } else {
+
+        face->linkState |= LINK_STATE_PEER_FULL;
+
+    }
+
+    return sendNow;
+
+}
+
+#endif
+
+#ifdef BLINKLIB_WIDE_VALUES
+
+// A new wide face value came in
+
+static void receiveWideValue( face_t *face , uint8_t f , uint16_t value ) {
+
+    if ( face->inWideValue != value ) {
+
+        face->inWideValue = value;
+        face->inValue = value & IR_DATA_VALUE_MAX;
+
+        SBI( irEventsPending.valueChanged , f );
+
+    }
+
+}
+
+#endif
+
+// A new face value came in
+
+static void receiveValue( face_t *face , uint8_t f , uint8_t value ) {
+
+    #ifdef BLINKLIB_WIDE_VALUES
+
+        receiveWideValue( face , f , value );       // From a neighbor that is not sending wide values
+
+    #else
+
+        if ( face->inValue != value ) {
+
+            face->inValue = value;
+
+            SBI( irEventsPending.valueChanged , f );
+
+        }
+
+    #endif
+
+}
+
+static void RX_IRFaces() {
+
+    //  Use these pointers to step though the arrays
+    face_t *face = faces;
+    volatile ir_rx_state_t *ir_rx_state = blinkbios_irdata_block.ir_rx_states;
+
+    for( uint8_t f=0; f < FACE_COUNT ; f++ ) {
+
+            // Check for anything new coming in...
+
+        if ( ir_rx_state->packetBufferReady && !IN_DATAGRAM_HELD( face ) ) {         // (a datagram we are holding for the user is not new)
+
+            LINK_STATS_COUNT( f , packetsReceived );
+
+            #ifdef BLINKLIB_RELIABLE_DATAGRAMS
+
+                if ( face->expireTime + ( LINK_RESET_TIME_MS - RX_EXPIRE_TIME_MS ) < now ) {
+
+                    // Nobody has been here for a good while, so this is a new neighbor (or one that went away and came back).
+                    // Start the sequence over and flip our epoch so they know to do the same, even if they
+                    // never noticed we were gone (maybe only our direction of the link was down).
+                    //
+                    // We do not do this as soon as the face expires since a couple of lost packets can do that, and if
+                    // the neighbor is still the same one, starting over could take a datagram twice or lose one.
+
+                    reliableLinkReset( face );
+
+                    face->linkState ^= LINK_STATE_EPOCH;
+
+                }
+
+            #endif
 
             // Got something, so we know there is someone out there
             // TODO: Should we require the received packet to pass error checks?
             face->expireTime = now + RX_EXPIRE_TIME_MS;
 
+            if ( !TBI( facesPresent , f ) ) {
+
+                // Every face already present got its expireTime before this one did, so this only moves the check time
+                // if nobody else is here
+
+                if ( !facesPresent ) {
+                    facesPresentCheckTime = face->expireTime;
+                }
+
+                SBI( facesPresent , f );
+                SBI( irEventsPending.arrived , f );
+            }
+
             // This is slightly ugly. To save a buffer, we get the full packet with the BlinkBIOS IR packet type byte.                       
 
             volatile const uint8_t *packetData = (ir_rx_state->packetBuffer);       
@@ -565,8 +1628,16 @@ static void RX_IRFaces() {
                 
                     // If we get here, then we know this is a valid packet
                 
+                    #ifdef BLINKLIB_RELIABLE_DATAGRAMS
+                        millis_t busySendTime = face->sendTime;     // In case we decide below not to answer this one after all
+                    #endif
+
                     // Clear to send on this face immediately to ping-pong messages at max speed without collisions
                     face->sendTime = 0;
+
+                    #ifdef BLINKLIB_ADAPTIVE_PROBE
+                        face->probeBackoff = 0;     // Someone is there, so back to probing at the regular pace
+                    #endif
                                 
                     if (irValueDecodePostponeSleepFlag(irDataFirstByte )) {
                     
@@ -584,34 +1655,209 @@ static void RX_IRFaces() {
 
                     uint8_t decodedByte = irValueDecodeData( irDataFirstByte );
                 
+                    #ifdef BLINKLIB_RELIABLE_DATAGRAMS
+
+                        // Every packet from a reliable neighbor has a link byte after the header. Datagrams are
+                        // covered by the checksum below, so we only look at the acknowledgement here on face values.
+
+                        uint8_t linkByte = packetData[1];
+
+                        if ( packetDataLen == 2 && LINK_BYTE_VALID( linkByte ) ) {
+
+                            receiveValue( face , f , decodedByte );
+
+                            if ( !reliableLinkReceive( face , linkByte ) ) {
+
+                                face->sendTime = busySendTime;      // Do not answer this one, see reliableLinkReceive()
+
+                            }
+
+                        } else 
+
+                    #endif
+
                     if ( packetDataLen == 1 ) {         // normal user face value, One header byte + One data byte
 
                         // We got a face value! Save it!
 
-                        face->inValue =decodedByte;
+                        receiveValue( face , f , decodedByte );
 
 
                     } else {        // (packetDataLen>1)  
                     
+                        #ifdef BLINKLIB_WIDE_VALUES
+
+                            if ( decodedByte == WIDE_VALUE_SPECIAL_VALUE && packetDataLen == 1 + DATAGRAM_LINK_LEN + WIDE_VALUE_LEN + 1 ) {
+
+                                // A wide face value. The checksum covers the link byte (if any) and the value.
+
+                                volatile const uint8_t *wideCheckedData = packetData + 1;      // Still the BIOS buffer
+                                const uint8_t wideCheckedLen = DATAGRAM_LINK_LEN + WIDE_VALUE_LEN;
+
+                                if ( computePacketChecksum( wideCheckedData , wideCheckedLen ) == wideCheckedData[ wideCheckedLen ] ) {
+
+                                    receiveWideValue( face , f , wideCheckedData[ DATAGRAM_LINK_LEN ] | ( wideCheckedData[ DATAGRAM_LINK_LEN + 1 ] << 8 ) );
+
+                                    #ifdef BLINKLIB_RELIABLE_DATAGRAMS
+
+                                        if ( !reliableLinkReceive( face , wideCheckedData[0] ) ) {
+
+                                            face->sendTime = busySendTime;      // Do not answer this one, see reliableLinkReceive()
+
+                                        }
+
+                                    #endif
+
+                                } else {
+
+                                    LINK_STATS_COUNT( f , checksumErrors );
+
+                                }
+
+                            } else
+
+                        #endif
                 
-                        if ( decodedByte == DATAGRAM_SPECIAL_VALUE) {
+                        if ( IS_DATAGRAM_FRAMED( decodedByte ) ) {         // A datagram (or a message fragment, which is framed the same way)
+
+                            boolean fecGood = true;
+
+                            #ifdef BLINKLIB_FEC_DATAGRAMS
+
+                                // Fix up what we can before the checksum gets a look at it. We own the BIOS buffer until we
+                                // clear packetBufferReady, so we can put it back together right there.
+
+                                fecGood = fecDecode( f , (uint8_t *) packetData + 1 , packetDataLen - 1 );
+
+                                packetDataLen = 1 + ( packetDataLen - 1 ) / 2;
+
+                            #endif
                         
-                            uint8_t datagramPayloadLen = packetDataLen-2;           // We deduct 2 from he length to account for the header byte and the trailing checksum byte                        
-                            const uint8_t *datagramPayloadData =   packetData+1;    // Skip the packet header byte
+                            uint8_t datagramPayloadLen = packetDataLen-2-DATAGRAM_PREFIX_LEN;   // We deduct 2 from he length to account for the header byte and the trailing checksum byte (and the link and value bytes if we have them)
+                            const uint8_t *datagramCheckedData =   packetData+1;                // Skip the packet header byte
+                            uint8_t datagramCheckedLen = datagramPayloadLen+DATAGRAM_PREFIX_LEN;
+
+                            #if defined( BLINKLIB_MESSAGES ) || !defined( BLINKLIB_ZERO_COPY_RX )
+                                const uint8_t *datagramPayloadData = datagramCheckedData+DATAGRAM_PREFIX_LEN;     // Only needed if we copy it out of the BIOS buffer
+                            #endif
+
+                            #if defined( BLINKLIB_MESSAGES ) || defined( BLINKLIB_RELIABLE_DATAGRAMS ) || defined( BLINKLIB_DATAGRAM_VALUES )
+
+                                uint8_t datagramPayloadMax = IR_DATAGRAM_LEN;
+
+                                #ifdef BLINKLIB_MESSAGES
+                                    if ( decodedByte == MESSAGE_FRAGMENT_SPECIAL_VALUE ) {
+                                        datagramPayloadMax = MESSAGE_FRAGMENT_LEN + 1;     // Fragment header byte + fragment
+                                    }
+                                #endif
+
+                            #endif
                         
                             // Long packets are kind of a special case since we do not mark them read immediately
-                            if ( computePacketChecksum( datagramPayloadData , datagramPayloadLen )  ==  datagramPayloadData[ datagramPayloadLen ] ) {        // Run checksum on payload bytes after the header, compare that to the checksum at the end
+                            if ( fecGood && computePacketChecksum( datagramCheckedData , datagramCheckedLen )  ==  datagramCheckedData[ datagramCheckedLen ] ) {        // Run checksum on bytes after the header, compare that to the checksum at the end
 
                                 // Ok this packet checks out folks!
                             
-                                if ( face->inDatagramLen == 0 && !(datagramPayloadLen > IR_DATAGRAM_LEN) ) {        // Check if buffer free and datagram not too long
+                                uint8_t slot = IN_DATAGRAM_TAIL( face );
+
+                                #ifdef BLINKLIB_DATAGRAM_VALUES
+
+                                    // The face value is good even if we end up not taking the datagram itself
+
+                                    if ( !(datagramPayloadLen > datagramPayloadMax) ) {    // Too short for the value also ends up here since the len wraps
+
+                                        #ifdef BLINKLIB_WIDE_VALUES
+                                            receiveWideValue( face , f , datagramCheckedData[ DATAGRAM_LINK_LEN ] | ( datagramCheckedData[ DATAGRAM_LINK_LEN + 1 ] << 8 ) );
+                                        #else
+                                            receiveValue( face , f , datagramCheckedData[ DATAGRAM_LINK_LEN ] );
+                                        #endif
+
+                                    }
+
+                                #endif
+
+                                #ifdef BLINKLIB_RELIABLE_DATAGRAMS
+
+                                    boolean duplicate = false;
+
+                                    if ( !(datagramPayloadLen > datagramPayloadMax) ) {    // Too short for a link byte also ends up here since the len wraps
+
+                                        uint8_t linkByte = datagramCheckedData[0];
+
+                                        reliableLinkReceive( face , linkByte );
+
+                                        // Not the sequence bit we expect means they did not get our ack for the last one and sent it again
+
+                                        duplicate = ( ( linkByte & LINK_SEQ_BIT ) ? 1 : 0 ) != ( ( face->linkState & LINK_STATE_RX_SEQ ) ? 1 : 0 );
+
+                                    }
+
+                                    if ( duplicate ) {
+
+                                        // Already have it. Our next packet will ack it again.
+
+                                    } else
+
+                                #endif
+
+                                #ifdef BLINKLIB_MESSAGES
+
+                                    if ( decodedByte == MESSAGE_FRAGMENT_SPECIAL_VALUE ) {
+
+                                        if ( datagramPayloadLen > datagramPayloadMax || datagramPayloadLen == 0 ) {
+
+                                            LINK_STATS_COUNT( f , datagramsDroppedOversize );
+
+                                        } else if ( receiveMessageFragment( face , datagramPayloadData , datagramPayloadLen ) ) {
+
+                                            #ifdef BLINKLIB_RELIABLE_DATAGRAMS
+                                                face->linkState ^= LINK_STATE_RX_SEQ;       // Took it, so ack it and expect the next one
+                                            #endif
+
+                                        } else {
+
+                                            LINK_STATS_COUNT( f , datagramsDroppedFull );
 
-                                    face->inDatagramLen = datagramPayloadLen;
+                                        }
+
+                                    } else
+
+                                #endif
+
+                                if ( face->inDatagramLen[ slot ] == 0 && !(datagramPayloadLen > IR_DATAGRAM_LEN) ) {        // Check if a slot is free and datagram not too long
+
+                                    face->inDatagramLen[ slot ] = datagramPayloadLen;
                                 
-                                    memcpy( face->inDatagramData  , datagramPayloadData , datagramPayloadLen);       // Skip the header bytes
+                                    #ifndef BLINKLIB_ZERO_COPY_RX
+                                        memcpy( face->inDatagramData[ slot ]  , datagramPayloadData , datagramPayloadLen);       // Skip the header bytes
+                                    #endif
+
+                                    #if IR_DATAGRAM_RX_SLOTS > 1
+                                        face->inDatagramTail = nextDatagramSlot( slot , IR_DATAGRAM_RX_SLOTS );
+                                    #endif
+
+                                    #ifdef BLINKLIB_RELIABLE_DATAGRAMS
+                                        face->linkState ^= LINK_STATE_RX_SEQ;       // Took it, so ack it and expect the next one
+                                    #endif
+
+                                    if ( face->inDatagramLen[ IN_DATAGRAM_HEAD( face ) ] ) {
+                                        SBI( irEvents.datagramsReady , f );
+                                    }
                                     
+                                } else if ( datagramPayloadLen > IR_DATAGRAM_LEN ) {
+
+                                    LINK_STATS_COUNT( f , datagramsDroppedOversize );
+
+                                } else {
+
+                                    LINK_STATS_COUNT( f , datagramsDroppedFull );
+
                                 }
                                                                                     
+                            } else {
+
+                                LINK_STATS_COUNT( f , checksumErrors );
+
                             }
 
                         } else {    // packetLen > 1 &&  decodedByte != LONG_DATA_SPECIAL_VALUE
@@ -630,82 +1876,414 @@ static void RX_IRFaces() {
 
                 } else {
                 
-                    // Invalid packet received. No good way to show or log this. :/
+                    // Invalid packet received. No good way to show this, but we can count it.
+
+                    LINK_STATS_COUNT( f , parityErrors );
                 
                     //#warning
                     //setColorNow( RED );                
 
                 }
                 
-            }                
+            } else {
+
+                LINK_STATS_COUNT( f , nonUserPackets );
+
+            }
             
             // No matter what, mark buffer as read so we can get next packet
-            ir_rx_state->packetBufferReady=0;
+            // (unless we are leaving a datagram in there for the user, then markDatagramReadOnFace() does it)
+
+            if ( !IN_DATAGRAM_HELD( face ) ) {
+                ir_rx_state->packetBufferReady=0;
+            }
                         
         }  // if ( ir_data_buffer->ready_flag )
 
-        face++;
-        ir_rx_state++;
+        face++;
+        ir_rx_state++;
+
+    } // for( uint8_t f=0; f < FACE_COUNT ; f++ )
+
+    // Did any of our neighbors go away? We only need to look once the earliest one could have expired.
+    // Packets that came in since then only push expire times later, so we might look a bit early, but never late.
+
+    if ( facesPresent && facesPresentCheckTime < now ) {
+
+        millis_t nextCheckTime = (millis_t) -1;
+
+        FOREACH_FACE( f ) {
+
+            if ( TBI( facesPresent , f ) ) {
+
+                millis_t expireTime = faces[f].expireTime;
+
+                if ( expireTime < now ) {
+
+                    CBI( facesPresent , f );
+                    SBI( irEventsPending.departed , f );
+
+                } else if ( expireTime < nextCheckTime ) {
+
+                    nextCheckTime = expireTime;
+
+                }
+
+            }
+
+        }
+
+        facesPresentCheckTime = nextCheckTime;
+
+    }
+
+}
+
+
+#if defined( BLINKLIB_RELIABLE_DATAGRAMS ) || defined( BLINKLIB_DATAGRAM_VALUES )
+
+// Put a new byte in front of the payload of a framed outgoing datagram (the link byte, or the face value).
+// The plain sum checksum we can fix up by taking the old byte out and adding the new one in, rather than
+// going over the whole thing again. A CRC the caller has to redo if we return 1.
+
+static uint8_t datagramPrefixUpdate( uint8_t *packet , uint8_t *checksum , uint8_t index , uint8_t b ) {
+
+    uint8_t old = packet[ index ];
+
+    if ( old == b ) {
+        return 0;
+    }
+
+    packet[ index ] = b;
+
+    #ifndef BLINKLIB_CRC8_DATAGRAMS
+        *checksum = ( ( *checksum ^ 0xff ) - old + b ) ^ 0xff;
+    #else
+        (void) checksum;
+    #endif
+
+    return 1;
+
+}
+
+#endif
+
+// Buffer to build each outgoing IR packet
+// This is the easy way to do this, but uses RAM unnecessarily.
+// TODO: Make a scatter version of this to save RAM & time
+
+// Datagrams do not need this since they are already framed in their outDatagramPacket
+
+#ifdef BLINKLIB_MESSAGES
+    static uint8_t ir_send_packet_buffer[ IR_RX_PACKET_SIZE - 1 ];      // Fragments fill up everything after the BIOS type byte
+#elif defined( BLINKLIB_FEC_DATAGRAMS )
+    static uint8_t ir_send_packet_buffer[ FEC_DATAGRAM_PACKET_LEN ];    // Datagrams get spread out into here
+#elif defined( BLINKLIB_WIDE_VALUES )
+    static uint8_t ir_send_packet_buffer[ 1 + DATAGRAM_LINK_LEN + WIDE_VALUE_LEN + 1 ];     // header byte + (link byte) + wide value + checksum
+#else
+    static uint8_t ir_send_packet_buffer[ 1 + DATAGRAM_LINK_LEN ];      // header byte + (link byte)
+#endif
+
+#ifdef BLINKLIB_ADAPTIVE_PROBE
+
+// How long to wait for an answer to what we just sent on this face before we send again.
+//
+// If nobody has been there for a while, each probe waits twice as long as the last, up to TX_PROBE_IDLE_MAX_MS, to save
+// on IR LED drive time. Otherwise if there is still something waiting to go out (or in reliable mode, to be acked) then
+// we do not want it stuck for a whole TX_PROBE_TIME_MS just because a packet got lost.
+
+static uint16_t nextProbeMs( face_t *face ) {
+
+    if ( face->expireTime < now ) {
+
+        uint16_t probeMs = TX_PROBE_TIME_MS << face->probeBackoff;
+
+        if ( probeMs < TX_PROBE_IDLE_MAX_MS ) {
+
+            face->probeBackoff++;
+
+            return probeMs;
+
+        }
+
+        return TX_PROBE_IDLE_MAX_MS;
+
+    }
+
+    face->probeBackoff = 0;
+
+    if ( nextOutgoing( face ) != OUTGOING_VALUE ) {
+        return TX_PROBE_BUSY_MS;
+    }
+
+    return TX_PROBE_TIME_MS;
+
+}
+
+#else
+
+    #define nextProbeMs( face ) TX_PROBE_TIME_MS
+
+#endif
+
+#ifdef BLINKLIB_CARRIER_SENSE
+
+// A tiny xorshift just for backoffs, so we neither use up nor depend on the sketch's random() sequence. It is seeded
+// from the serial number the first time though so that two neighbors do not pick the same backoffs and collide again.
+
+static uint8_t backoffState;
+
+// Returns a random 1-TX_BACKOFF_MAX_MS
+
+static uint8_t txBackoffMs() {
+
+    uint8_t x = backoffState;
+
+    if ( !x ) {
+
+        for( uint8_t n = 0 ; n <= 8 ; n++ ) {
+            x ^= getSerialNumberByte( n );
+        }
+
+        if ( !x ) {
+            x = 1;          // Has to start out non-zero
+        }
+
+    }
+
+    x ^= x << 3;
+    x ^= x >> 5;
+    x ^= x << 4;
+
+    backoffState = x;
+
+    return 1 + ( x & ( TX_BACKOFF_MAX_MS - 1 ) );
+
+}
+
+#endif
+
+static void TX_IRFaces() {
+
+    //  Use these pointers to step though the arrays
+    face_t *face = faces;
+
+    for( uint8_t f=0; f < FACE_COUNT ; f++ ) {
+        
+        #ifdef BLINKLIB_CARRIER_SENSE
+
+            // Listen before we talk. If the neighbor is in the middle of sending to us then anything we send now would just
+            // crash into it. Once theirs comes in we get to answer right away anyway (it sets sendTime to 0), so the backoff
+            // only matters if what was coming in turns out to be junk. Saves building a packet just to have the BIOS turn it down.
+
+            if ( face->sendTime <= now && blinkbios_is_rx_in_progress( f ) ) {
+
+                face->sendTime = now + txBackoffMs();
+
+                LINK_STATS_COUNT( f , sendsDeferred );
+
+            }
+
+        #endif
+
+        // Send one out too if it is time....
+
+        if ( face->sendTime <= now ) {        // Time to send on this face?
+                                              // Note that we do not use the rx_fresh flag here because we want the timeout
+                                              // to do automatic retries to kickstart things when a new neighbor shows up or
+                                              // when an IR message gets missed
+                   
+            uint8_t *outgoingPacket = ir_send_packet_buffer;    // The packet we will send
+            uint8_t outgoingPacketLen;              // Total length of the outgoing packet
+            uint8_t outgoiungPacketHeaderValue;     // Value to encode into first byte of outgoing IR packet before transmitting
+                                                                      
+            // Ok, it is time to send something on this face
+            // Do we have a pending datagram? If so, datagrams get priority over face values
+                                    
+            uint8_t outSlot = OUT_DATAGRAM_HEAD( face );     // Oldest waiting datagram, if any
+
+            #if defined( BLINKLIB_BROADCAST_DATAGRAMS ) && defined( BLINKLIB_RELIABLE_DATAGRAMS )
+
+                // Nobody has been on this face for long enough that the link will start over when someone
+                // shows up, so nobody is going to ack the broadcast here. Do not hold it up on the other faces.
+
+                if ( TBI( broadcastFaces , f ) && face->expireTime + ( LINK_RESET_TIME_MS - RX_EXPIRE_TIME_MS ) < now ) {
+
+                    CBI( broadcastFaces , f );
+
+                    if ( face->linkState & LINK_STATE_TX_BROADCAST ) {
+                        face->linkState &= ~( LINK_STATE_TX_BUSY | LINK_STATE_TX_BROADCAST );
+                    }
+
+                }
+
+            #endif
+
+            uint8_t outgoing = nextOutgoing( face );
+
+            #ifdef BLINKLIB_RELIABLE_DATAGRAMS
+                uint8_t linkByte = reliableLinkByte( face );
+                ir_send_packet_buffer[1] = linkByte;        // Every packet gets the link byte after the header
+            #endif
+
+            if ( outgoing == OUTGOING_DATAGRAM || outgoing == OUTGOING_BROADCAST ) {
+                
+                outgoiungPacketHeaderValue = DATAGRAM_SPECIAL_VALUE;
+
+                // The datagram is already framed with its payload and checksum by commitDatagramOnFace(),
+                // so we can send it right from where it is. Only the header (added below) is left.
+
+                outgoingPacket = face->outDatagramPacket[ outSlot ];
+
+                uint8_t datagramPayloadLen  = face->outDatagramLen[ outSlot ];
+
+                #ifdef BLINKLIB_BROADCAST_DATAGRAMS
+
+                    if ( outgoing == OUTGOING_BROADCAST ) {
+
+                        // Same deal, but from the copy every face shares
+
+                        outgoingPacket = broadcastPacket;
+                        datagramPayloadLen = broadcastLen;
+
+                    }
+
+                #endif
+
+                #if defined( BLINKLIB_RELIABLE_DATAGRAMS ) || defined( BLINKLIB_DATAGRAM_VALUES )
+
+                    // Swap the link byte and face value from last time for the current ones.
 
-    } // for( uint8_t f=0; f < FACE_COUNT ; f++ )
+                    uint8_t *checksum = &outgoingPacket[ OUT_DATAGRAM_OFFSET + datagramPayloadLen ];
 
-}
+                    uint8_t prefixChanged = 0;
 
+                    #ifdef BLINKLIB_RELIABLE_DATAGRAMS
+                        prefixChanged |= datagramPrefixUpdate( outgoingPacket , checksum , 1 , linkByte );
+                    #endif
 
-// Buffer to build each outgoing IR packet
-// This is the easy way to do this, but uses RAM unnecessarily.
-// TODO: Make a scatter version of this to save RAM & time
+                    #ifdef BLINKLIB_DATAGRAM_VALUES
+                        #ifdef BLINKLIB_WIDE_VALUES
+                            prefixChanged |= datagramPrefixUpdate( outgoingPacket , checksum , 1 + DATAGRAM_LINK_LEN , face->outWideValue & 0xff );
+                            prefixChanged |= datagramPrefixUpdate( outgoingPacket , checksum , 2 + DATAGRAM_LINK_LEN , face->outWideValue >> 8 );
+                        #else
+                            prefixChanged |= datagramPrefixUpdate( outgoingPacket , checksum , 1 + DATAGRAM_LINK_LEN , face->outValue );
+                        #endif
+                    #endif
 
-static uint8_t ir_send_packet_buffer[ IR_DATAGRAM_LEN + 2 ];    // header byte + Datagram payload  + checksum byte
+                    #ifdef BLINKLIB_CRC8_DATAGRAMS
 
-static void TX_IRFaces() {
+                        // No shortcut for a CRC, so it has to go over the whole thing again. Resends usually
+                        // have the same link byte and value as last time though, so skip it when nothing changed.
 
-    //  Use these pointers to step though the arrays
-    face_t *face = faces;
+                        if ( prefixChanged ) {
 
-    for( uint8_t f=0; f < FACE_COUNT ; f++ ) {
-        
-        // Send one out too if it is time....
+                            *checksum = computePacketChecksum( outgoingPacket + 1 , DATAGRAM_PREFIX_LEN + datagramPayloadLen );
 
-        if ( face->sendTime <= now ) {        // Time to send on this face?
-                                              // Note that we do not use the rx_fresh flag here because we want the timeout
-                                              // to do automatic retries to kickstart things when a new neighbor shows up or
-                                              // when an IR message gets missed
-                   
-            uint8_t outgoingPacketLen;              // Total length of the outgoing packet in ir_send_packet_buffer
-            uint8_t outgoiungPacketHeaderValue;     // Value to encode into first byte of outgoing IR packet before transmitting
-                                                                      
-            // Ok, it is time to send something on this face
-            // Do we have a pending datagram? If so, datagrams get priority over face values
-                                    
-            if (face->outDatagramLen) {
-                
-                outgoiungPacketHeaderValue = DATAGRAM_SPECIAL_VALUE;
+                        }
 
-                // Build a datagram into the outgoing buffer including checksum
-                                
-                uint8_t *d = ir_send_packet_buffer+1;           // Data goes after the 1st byte header            
-                const uint8_t *s = face->outDatagramData ;      // Just to convert from void to uint8_t
+                    #else
 
-                uint8_t datagramPayloadLen  = face->outDatagramLen;
-                                
-                memcpy( d, s , datagramPayloadLen );
-                                                
-                // First header, then payload, when checksum 
-                 ir_send_packet_buffer[1+datagramPayloadLen] = computePacketChecksum( s , datagramPayloadLen );
+                        (void) prefixChanged;       // datagramPrefixUpdate() already fixed up the checksum
+
+                    #endif
 
-                outgoingPacketLen = 1 + datagramPayloadLen +1;       // include header byte + payload + checksum (header added below)
+                #endif
+
+                outgoingPacketLen = OUT_DATAGRAM_OFFSET + datagramPayloadLen +1;       // include header byte + (link byte) + (value) + payload + checksum
                                 
                 // Note that the outgoing datagram buffer will be cleared below if the IR send succeeds
                 
+            #ifdef BLINKLIB_MESSAGES
+
+            } else if ( outgoing == OUTGOING_FRAGMENT ) {
+
+                outgoiungPacketHeaderValue = MESSAGE_FRAGMENT_SPECIAL_VALUE;
+
+                // Next fragment of the message. Every one but the last is full.
+
+                uint16_t offset = face->outMessageFragment * (uint16_t) MESSAGE_FRAGMENT_LEN;
+                uint16_t remaining = face->outMessageLen - offset;
+
+                uint8_t fragmentHeader = face->outMessageFragment;
+                uint8_t fragmentLen;
+
+                if ( remaining > MESSAGE_FRAGMENT_LEN ) {
+                    fragmentLen = MESSAGE_FRAGMENT_LEN;
+                } else {
+                    fragmentLen = remaining;
+                    fragmentHeader |= MESSAGE_FRAGMENT_LAST_BIT;
+                }
+
+                #ifdef BLINKLIB_DATAGRAM_VALUES
+                    #ifdef BLINKLIB_WIDE_VALUES
+                        ir_send_packet_buffer[1+DATAGRAM_LINK_LEN] = face->outWideValue & 0xff;
+                        ir_send_packet_buffer[2+DATAGRAM_LINK_LEN] = face->outWideValue >> 8;
+                    #else
+                        ir_send_packet_buffer[1+DATAGRAM_LINK_LEN] = face->outValue;
+                    #endif
+                #endif
+
+                ir_send_packet_buffer[1+DATAGRAM_PREFIX_LEN] = fragmentHeader;
+
+                memcpy( ir_send_packet_buffer+2+DATAGRAM_PREFIX_LEN , face->outMessageData + offset , fragmentLen );
+
+                // Checksum covers the link byte, value, fragment header, and fragment
+
+                uint8_t checkedLen = DATAGRAM_PREFIX_LEN + 1 + fragmentLen;
+
+                ir_send_packet_buffer[1+checkedLen] = computePacketChecksum( ir_send_packet_buffer+1 , checkedLen );
+
+                outgoingPacketLen = 1 + checkedLen + 1;
+
+            #endif
+
             } else {    
                 
                 // Just send a normal face value                                
                 outgoiungPacketHeaderValue = face->outValue;
                 outgoingPacketLen=1;
+
+                #ifdef BLINKLIB_RELIABLE_DATAGRAMS
+
+                    // Piggyback our ack on the face value
+
+                    outgoingPacketLen=2;
+
+                #endif
+
+                #ifdef BLINKLIB_WIDE_VALUES
+
+                    // The whole value goes after the header (and link byte), checked like a datagram
+
+                    outgoiungPacketHeaderValue = WIDE_VALUE_SPECIAL_VALUE;
+
+                    ir_send_packet_buffer[ 1 + DATAGRAM_LINK_LEN ] = face->outWideValue & 0xff;
+                    ir_send_packet_buffer[ 2 + DATAGRAM_LINK_LEN ] = face->outWideValue >> 8;
+
+                    ir_send_packet_buffer[ 1 + DATAGRAM_LINK_LEN + WIDE_VALUE_LEN ] = computePacketChecksum( ir_send_packet_buffer + 1 , DATAGRAM_LINK_LEN + WIDE_VALUE_LEN );
+
+                    outgoingPacketLen = 1 + DATAGRAM_LINK_LEN + WIDE_VALUE_LEN + 1;
+
+                #endif
                                 
             }       
 
+            #ifdef BLINKLIB_FEC_DATAGRAMS
+
+                if ( outgoing != OUTGOING_VALUE ) {
+
+                    // Spread out everything after the header into ir_send_packet_buffer. A fragment is already in
+                    // there, which is fine since fecEncode() can work in place.
+
+                    outgoingPacketLen = 1 + fecEncode( ir_send_packet_buffer + 1 , outgoingPacket + 1 , outgoingPacketLen - 1 );
+
+                    outgoingPacket = ir_send_packet_buffer;
+
+                }
+
+            #endif
+
             // Encode the header byte with the parity and viral button flag            
                                               
             uint8_t encodedIrValue; 
@@ -725,9 +2303,9 @@ static void TX_IRFaces() {
                 
             }
             
-            ir_send_packet_buffer[0] = encodedIrValue;  // store the encoded header into the outgoing buffer
+            outgoingPacket[0] = encodedIrValue;  // store the encoded header into the outgoing buffer
 
-            if (blinkbios_irdata_send_packet( f , ir_send_packet_buffer  , outgoingPacketLen ) ) {
+            if (blinkbios_irdata_send_packet( f , outgoingPacket  , outgoingPacketLen ) ) {
                 
                 // Here we set a timeout to keep periodically probing on this face, but
                 // if there is a neighbor, they will send back to us as soon as they get what we
@@ -741,25 +2319,79 @@ static void TX_IRFaces() {
 				// otherwise the degenerate case is that they can all happen repeatedly in the same
 				// pass thugh loop() every time when there are no neighbors.
                 
-				 
-                face->sendTime = now + TX_PROBE_TIME_MS + f;	
-                
                 
-                // Mark any pending datagram as sent
-                // safe to do this blindly because datagram always gets priority so it would have been 
-                // what was just sent if there was one pending
-                face->outDatagramLen = 0;
+                #ifndef BLINKLIB_RELIABLE_DATAGRAMS
+
+                    // Mark any pending datagram (or fragment) as sent and move on to the next one
+
+                    outgoingDone( face , outgoing );
+
+                #else
+
+                    // Remember what we are waiting on an ack for
+
+                    if ( outgoing == OUTGOING_DATAGRAM ) {
+                        face->linkState |= LINK_STATE_TX_BUSY;
+                    } else if ( outgoing == OUTGOING_FRAGMENT ) {
+                        face->linkState |= LINK_STATE_TX_BUSY | LINK_STATE_TX_FRAGMENT;
+                    } else if ( outgoing == OUTGOING_BROADCAST ) {
+                        face->linkState |= LINK_STATE_TX_BUSY | LINK_STATE_TX_BROADCAST;
+                    }
+
+                #endif
+
+                // In reliable mode the datagram stays at the front of the queue until the neighbor acks it. Until
+                // then we send it again every time we get to send on this face (when they answer, or at the probe time).
+
+                // Now that the queue is up to date, nextProbeMs() can see if anything is still waiting to go out
+
+                #ifdef BLINKLIB_CARRIER_SENSE
+
+                    // A random spread instead, so that if this one collides with a probe from the neighbor, the
+                    // two of us will not just collide again on the next probe
+
+                    face->sendTime = now + nextProbeMs( face ) + txBackoffMs();
+
+                #else
+
+                    face->sendTime = now + nextProbeMs( face ) + f;	
+
+                #endif
                 
+            } else {
+
+                LINK_STATS_COUNT( f , sendsRejected );
+
+                #ifdef BLINKLIB_CARRIER_SENSE
+                    face->sendTime = now + txBackoffMs();       // Something started coming in between when we checked and now
+                #endif
+
             }
 
         } // if ( face->sendTime <= now )
 
+        // Next time we need to do something on this face even if nothing comes in
+
+        BLINKBIOS_WAKE_HINT( face->sendTime );
+        BLINKBIOS_WAKE_HINT( face->expireTime + 1 );
+
         face++;
 
     } // for( uint8_t f=0; f < FACE_COUNT ; f++ )
 
 }
 
+// Normally run() only does RX_IRFaces() before loop() and TX_IRFaces() after the display update, so something coming
+// in just after the RX has to wait most of a frame before loop() sees it, and our answer waits for the display too.
+// This lets a sketch do both right now. We do not update `now` so that millis() and timers do not move under loop().
+
+void pollIR() {
+
+    RX_IRFaces();
+    TX_IRFaces();
+
+}
+
 
 // Returns the last received state on the indicated face
 // Remember that getNeighborState() starts at 0 on powerup.
@@ -773,22 +2405,21 @@ byte getLastValueReceivedOnFace( byte face ) {
 
 }
 
-// Did the neighborState value on this face change since the
-// last time we checked?
+// Did the neighborState value on this face change this frame?
 // Remember that getNeighborState starts at 0 on powerup.
 // Note the a face expiring has no effect on the getNeighborState()
+// This used to keep its own copy of the last value it saw, which meant that a second call in the same
+// loop() always said no. Now it is just the event bit, so you can ask as many times as you like.
 
 byte didValueOnFaceChange( byte face ) {
-    static byte prevState[FACE_COUNT];
 
-    byte curState = getLastValueReceivedOnFace(face);
+    return TBI( irEvents.valueChanged , face ) != 0;
 
-    if ( curState == prevState[face] ) {
-        return false;
-    }
-    prevState[face] = curState;
+}
 
-    return true;
+const irEvents_t *getIREvents() {
+
+    return &irEvents;
 
 }
 
@@ -796,7 +2427,7 @@ byte didValueOnFaceChange( byte face ) {
 
 byte isValueReceivedOnFaceExpired( byte face ) {
 
-    return faces[face].expireTime < now;
+    return !TBI( facesPresent , face );
 
 }
 
@@ -804,14 +2435,66 @@ byte isValueReceivedOnFaceExpired( byte face ) {
 
 bool isAlone() {
 
-	FOREACH_FACE(f) {
+    return !facesPresent;
+
+}
+
+byte getFacesPresent() {
+
+    return facesPresent;
+
+}
+
+// Which faces have a neighbor whose last value, after masking, matches the pattern?
+// One pass over the faces building the bitmask as we go, so it is cheaper than a FOREACH_FACE in the sketch
+// that calls isValueReceivedOnFaceExpired() and getLastValueReceivedOnFace() on each face.
+
+byte facesWithValueMask( byte mask , byte pattern ) {
+
+    byte matching = 0;
+
+    face_t *face = faces;
+
+    for( byte bit = 1 ; bit < ( 1 << FACE_COUNT ) ; bit <<= 1 ) {
+
+        if ( ( face->inValue & mask ) == pattern ) {
+            matching |= bit;
+        }
+
+        face++;
+
+    }
+
+    // Values hang around after a face expires, so only count the ones that are still there
+
+    return matching & facesPresent;
+
+}
+
+byte facesWithValue( byte value ) {
+
+    return facesWithValueMask( 0xff , value );
+
+}
+
+byte countNeighborsMatching( byte mask , byte pattern ) {
+
+    byte matching = facesWithValueMask( mask , pattern );
+
+    byte count = 0;
+
+    while ( matching ) {
+        matching &= matching - 1;       // Clear the lowest set bit
+        count++;
+    }
+
+    return count;
 
-		if( !isValueReceivedOnFaceExpired(f) ) {
-			return false;
-		}
+}
+
+bool anyNeighborInState( byte mask , byte pattern ) {
 
-	}
-	return true;
+    return facesWithValueMask( mask , pattern ) != 0;
 
 }
 
@@ -831,7 +2514,7 @@ void setValueSentOnAllFaces( byte value ) {
 
     FOREACH_FACE(f) {
 
-        faces[f].outValue = value;
+        setValueSentOnFace( value , f );
 
     }
 
@@ -850,10 +2533,57 @@ void setValueSentOnFace( byte value , byte face ) {
 
      }
 
-    faces[face].outValue = value;
+    #ifdef BLINKLIB_WIDE_VALUES
+
+        setWideValueSentOnFace( value , face );
+
+    #else
+
+        if ( faces[face].outValue != value ) {
+
+            faces[face].outValue = value;
+
+            probeSoon( &faces[face] );
+
+        }
+
+    #endif
+
+}
+
+#ifdef BLINKLIB_WIDE_VALUES
+
+void setWideValueSentOnFace( uint16_t value , byte face ) {
+
+    if ( faces[face].outWideValue != value ) {
+
+        faces[face].outWideValue = value;
+        faces[face].outValue = value & IR_DATA_VALUE_MAX;
+
+        probeSoon( &faces[face] );
+
+    }
+
+}
+
+void setWideValueSentOnAllFaces( uint16_t value ) {
+
+    FOREACH_FACE(f) {
+
+        setWideValueSentOnFace( value , f );
+
+    }
+
+}
+
+uint16_t getWideValueReceivedOnFace( byte face ) {
+
+    return faces[face].inWideValue;
 
 }
 
+#endif
+
 
 
 // --------------Button code
@@ -1007,7 +2737,9 @@ void randomize() {
     for( uint8_t bit=32; bit; bit-- ) {
                                
         blinkbios_pixel_block.capturedEntropy=0;                                                          // Clear this so we can check to see when it gets set in the background               
-        while (blinkbios_pixel_block.capturedEntropy==0 || blinkbios_pixel_block.capturedEntropy==1  );   // Wait for this to get set in the background when the WDT ISR fires
+        while (blinkbios_pixel_block.capturedEntropy==0 || blinkbios_pixel_block.capturedEntropy==1  ) {  // Wait for this to get set in the background when the WDT ISR fires
+            BLINKBIOS_SPIN_YIELD();
+        }
                                                                                                           // We also ignore 1 to stay balanced since 0 is a valid possible TCNT value that we will ignore                               
         rand_state <<=1;
         rand_state |= blinkbios_pixel_block.capturedEntropy & 0x01;            // Grab just the bottom bit each time to try and maximum entropy
@@ -1046,7 +2778,7 @@ word randomWord(void) {
 // return a random number between 0 and limit inclusive.
 // https://stackoverflow.com/a/2999130/3152071
 
-word random( uint16_t limit ) {
+word random( word limit ) {
 
     word divisor = GETNEXTRANDUINT_MAX/(limit+1);
     word retval;
@@ -1125,7 +2857,11 @@ word map(word x, word in_min, word in_max, word out_min, word out_max)
 // As per "13.6.8.1. SNOBRx - Serial Number Byte 8 to 0"
 
 
-const byte * const serialno_addr = ( const byte *)   0xF0;
+#ifndef BLINKLIB_SERIALNO_ADDR
+    #define BLINKLIB_SERIALNO_ADDR 0xF0
+#endif
+
+const byte * const serialno_addr = ( const byte *)   BLINKLIB_SERIALNO_ADDR;
 
 
 // Read the unique serial number for this blink tile
@@ -1313,6 +3049,193 @@ byte sin8_C( byte theta)
     
     
 
+#endif
+
+// Build with -DBLINKLIB_FRAME_PROFILE (a compiler flag, see Build options in blinklib.h) to time each phase of every pass though run() and print a summary out the service port
+// every FRAME_PROFILE_REPORT_MS. Costs about 160 bytes of RAM and a bit of time every frame, so only for measuring.
+//
+// Times are in microseconds. Each line looks like...
+//
+//    loop n=90 min=432 mean=2208 max=6952 hist=12,70,8,0,0,0,0,0
+//
+// ...where the histogram buckets are <1ms, <2ms, <4ms, <8ms, <16ms, <32ms, <64ms, and >=64ms.
+// Resolution is the BIOS timer tick (`millis` plus `step_8us`), so very short phases can show up as 0.
+
+#ifdef BLINKLIB_FRAME_PROFILE
+
+    #include "Serial.h"
+
+    #ifndef FRAME_PROFILE_REPORT_MS
+        #define FRAME_PROFILE_REPORT_MS 5000
+    #endif
+
+    enum {
+        FRAME_PROFILE_BUTTON,               // Stack check, seed & sleep gestures, and the button snapshot
+        FRAME_PROFILE_RX,                   // RX_IRFaces()
+        FRAME_PROFILE_LOOP,                 // loop()
+        FRAME_PROFILE_DISPLAY,              // BLINKBIOS_DISPLAY_PIXEL_BUFFER_VECTOR(), which waits for the next refresh
+        FRAME_PROFILE_TX,                   // TX_IRFaces()
+        FRAME_PROFILE_FRAME,                // The whole thing
+        FRAME_PROFILE_PHASE_COUNT
+    };
+
+    #define FRAME_PROFILE_BUCKET_COUNT 8
+
+    static const char frame_profile_names[ FRAME_PROFILE_PHASE_COUNT ][ 8 ] PROGMEM = {
+        "button" , "rx" , "loop" , "display" , "tx" , "frame"
+    };
+
+    struct frame_profile_phase_t {
+        uint16_t min;                       // All in 8us steps
+        uint16_t max;
+        uint32_t total;
+        uint16_t histogram[ FRAME_PROFILE_BUCKET_COUNT ];
+    };
+
+    static frame_profile_phase_t frame_profile_phases[ FRAME_PROFILE_PHASE_COUNT ];
+
+    static uint16_t frame_profile_count;
+
+    static uint32_t frame_profile_frame_start;
+    static uint32_t frame_profile_phase_start;
+
+    static Timer frame_profile_report_timer;
+
+    static ServicePortSerial frame_profile_sp;
+
+    // Current time in 8us steps. Wraps every 9.5 hours, which is fine since we only ever look at short differences.
+
+    static uint32_t frame_profile_time() {
+
+        cli();
+        uint32_t t = ( blinkbios_millis_block.millis * 125 ) + blinkbios_millis_block.step_8us;
+        sei();
+
+        return t;
+
+    }
+
+    static void frame_profile_reset() {
+
+        memset( frame_profile_phases , 0 , sizeof( frame_profile_phases ) );
+
+        for( uint8_t p = 0 ; p < FRAME_PROFILE_PHASE_COUNT ; p++ ) {
+            frame_profile_phases[p].min = UINT16_MAX;
+        }
+
+        frame_profile_count = 0;
+
+        frame_profile_report_timer.set( FRAME_PROFILE_REPORT_MS );
+
+    }
+
+    static void frame_profile_record( uint8_t phase , uint32_t steps ) {
+
+        frame_profile_phase_t *p = &frame_profile_phases[ phase ];
+
+        uint16_t s = ( steps > UINT16_MAX ) ? UINT16_MAX : steps;       // Half a second is plenty
+
+        if ( s < p->min ) p->min = s;
+        if ( s > p->max ) p->max = s;
+
+        p->total += s;
+
+        // Bucket is the number of bits in the whole milliseconds, so each one is twice as wide as the last
+
+        uint8_t ms = ( s >= 125U * 255 ) ? 255 : s / 125;
+        uint8_t bucket = 0;
+
+        while ( ms && bucket < FRAME_PROFILE_BUCKET_COUNT - 1 ) {
+            ms >>= 1;
+            bucket++;
+        }
+
+        p->histogram[ bucket ]++;
+
+    }
+
+    static void frame_profile_init() {
+
+        frame_profile_sp.begin();
+        frame_profile_reset();
+
+    }
+
+    // Call at the top of the frame
+
+    static void frame_profile_start() {
+
+        frame_profile_frame_start = frame_profile_phase_start = frame_profile_time();
+
+    }
+
+    // Call at the end of each phase
+
+    static void frame_profile_mark( uint8_t phase ) {
+
+        uint32_t t = frame_profile_time();
+
+        frame_profile_record( phase , t - frame_profile_phase_start );
+
+        frame_profile_phase_start = t;
+
+    }
+
+    static void frame_profile_report() {
+
+        for( uint8_t p = 0 ; p < FRAME_PROFILE_PHASE_COUNT ; p++ ) {
+
+            const frame_profile_phase_t *phase = &frame_profile_phases[p];
+
+            frame_profile_sp.print( FPSTR( frame_profile_names[p] ) );
+            frame_profile_sp.print( F(" n=") );
+            frame_profile_sp.print( frame_profile_count );
+            frame_profile_sp.print( F(" min=") );
+            frame_profile_sp.print( phase->min * 8UL );
+            frame_profile_sp.print( F(" mean=") );
+            frame_profile_sp.print( ( phase->total / frame_profile_count ) * 8UL );
+            frame_profile_sp.print( F(" max=") );
+            frame_profile_sp.print( phase->max * 8UL );
+            frame_profile_sp.print( F(" hist=") );
+
+            for( uint8_t b = 0 ; b < FRAME_PROFILE_BUCKET_COUNT ; b++ ) {
+                if (b) frame_profile_sp.print( ',' );
+                frame_profile_sp.print( phase->histogram[b] );
+            }
+
+            frame_profile_sp.println();
+
+        }
+
+    }
+
+    // Call at the end of the frame. Any printing happens here, after we have stopped the clock on this frame and before
+    // we start it on the next one, so it does not show up in the numbers.
+
+    static void frame_profile_end() {
+
+        frame_profile_mark( FRAME_PROFILE_TX );
+
+        frame_profile_record( FRAME_PROFILE_FRAME , frame_profile_phase_start - frame_profile_frame_start );
+
+        frame_profile_count++;
+
+        if ( frame_profile_report_timer.isExpired() ) {
+
+            frame_profile_report();
+            frame_profile_reset();
+
+        }
+
+    }
+
+#else
+
+    #define frame_profile_init()
+    #define frame_profile_start()
+    #define frame_profile_mark( phase )
+    #define frame_profile_end()
+
 #endif
 
 // This is the main event loop that calls into the arduino program
@@ -1333,7 +3256,11 @@ void __attribute__((noreturn)) run(void)  {
 
     setup();
 
+    frame_profile_init();
+
     while (1) {
+
+        frame_profile_start();
         
         // Did we blow the stack?
         
@@ -1429,21 +3356,41 @@ void __attribute__((noreturn)) run(void)  {
         buttonSnapshotClickcount = blinkbios_button_block.clickcount;
         sei();
 
+        frame_profile_mark( FRAME_PROFILE_BUTTON );
 
         // Update the IR RX state
         // Receive any pending packets
         RX_IRFaces();
 
+        // New frame, new events. These are everything since the last frame started, including whatever pollIR() took in
+        // during the last loop() after it had already looked. (datagramsReady is not an event, it stays set until they are read)
+
+        irEvents.valueChanged = irEventsPending.valueChanged;
+        irEvents.arrived      = irEventsPending.arrived;
+        irEvents.departed     = irEventsPending.departed;
+
+        irEventsPending.valueChanged = 0;
+        irEventsPending.arrived = 0;
+        irEventsPending.departed = 0;
+
+        frame_profile_mark( FRAME_PROFILE_RX );
+
         loop();
 
+        frame_profile_mark( FRAME_PROFILE_LOOP );
+
         // Update the pixels to match our buffer
 
         BLINKBIOS_DISPLAY_PIXEL_BUFFER_VECTOR();
 
+        frame_profile_mark( FRAME_PROFILE_DISPLAY );
+
         // Transmit any IR packets waiting to go out
         // Note that we do this after loop had a chance to update them.
         TX_IRFaces();
 
+        frame_profile_end();
+
         if (warm_sleep_time.isExpired()) {
 
             warm_sleep_cycle();
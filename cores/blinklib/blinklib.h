@@ -25,6 +25,19 @@
 
 #define FACE_COUNT 6
 
+// Build options
+//
+// blinklib has optional features that you turn on with the BLINKLIB_* flags below (and a few sizes like
+// IR_DATAGRAM_RX_SLOTS). blinklib.cpp is compiled on its own, not as part of your sketch, so a #define in your sketch
+// never reaches it. Worse, your sketch would then see different structs and functions than blinklib was built with.
+// So these must be global compiler flags that every file gets. In the Arduino IDE, make a platform.local.txt file
+// next to platform.txt in the Blinks core folder with a line like this (flags separated by spaces)...
+//
+//     compiler.cpp.extra_flags=-DBLINKLIB_RELIABLE_DATAGRAMS -DBLINKLIB_LINK_STATS
+//
+// ...and restart the IDE. Or add them to build.extra_flags for the board in boards.txt. Either way every sketch you
+// build gets them until you take them out again.
+
 /*
 
     IR communications functions
@@ -43,8 +56,13 @@
 
 byte getLastValueReceivedOnFace( byte face );
 
-// Did the neighborState value on this face change since the
-// last time we checked?
+// Did the value received on this face change this frame?
+// You can call this as many times as you like in a loop(), it gives the same answer until the next frame.
+//
+// NOTE: This used to mean "did it change since the last time you called this", and it only said yes once. Now it only
+// looks at this frame. If your sketch does not call it every frame (say, only while in some state, or only every
+// so often from a Timer), a change that happened on a frame where you did not ask is never reported. Check it every
+// frame, or compare getLastValueReceivedOnFace() against your own copy instead.
 
 // Note the a face expiring has no effect on the last value
 
@@ -58,6 +76,24 @@ byte isValueReceivedOnFaceExpired( byte face );
 // Returns false if their has been a neighbor seen recently on any face, returns true otherwise.
 bool isAlone();
 
+// Returns a bit for each face that has a neighbor (bit 0 is face 0), so the faces that are not expired.
+// Cheaper than asking each face, and `__builtin_popcount( getFacesPresent() )` tells you how many neighbors you have.
+
+byte getFacesPresent();
+
+// Ask about all of your neighbors at once. These only look at faces that have a neighbor, and answer with a bit for
+// each matching face like getFacesPresent(). A neighbor matches when `( value & mask ) == pattern`, so if you pack a
+// game state into the low 2 bits of your value then `facesWithValueMask( 0b11 , HOORAY )` finds every neighbor in HOORAY
+// no matter what else they are sending.
+
+byte facesWithValue( byte value );
+byte facesWithValueMask( byte mask , byte pattern );
+
+// How many neighbors match, and are there any at all?
+
+byte countNeighborsMatching( byte mask , byte pattern );
+bool anyNeighborInState( byte mask , byte pattern );
+
 // Set value that will be continuously broadcast on specified face.
 // Value should be between 0 and IR_DATA_VALUE_MAX inclusive.
 // If a value greater than IR_DATA_VALUE_MAX is specified, IR_DATA_VALUE_MAX will be sent.
@@ -69,6 +105,31 @@ void setValueSentOnFace( byte value , byte face );
 
 void setValueSentOnAllFaces( byte value );
 
+// IR packets normally come in once per frame just before loop() is called, and go out once per frame after it returns
+// and the pixels have been updated. Call pollIR() from inside loop() to take in anything that has arrived and send
+// anything that is ready right now, so a change can get across a link without waiting for the next frame. Handy for
+// reflex games where a reaction has to ripple down a long chain of tiles.
+//
+// Everything you have already read (values, datagrams) stays put, but the get functions will see whatever just came in.
+// The events for what came in (didValueOnFaceChange(), getIREvents()) wait for the next frame, so you see each one once
+// even if you already looked this frame. millis() does not change.
+
+void pollIR();
+
+// Rather than checking every face one at a time to see what is new, you can get all of it at once. Each field has
+// a bit for each face (bit 0 is face 0), so `if ( getIREvents()->arrived )` tells you if anyone showed up anywhere.
+// Events are for everything that came in since the last frame started, including anything pollIR() took in during the
+// last loop(), and stay the same for the whole of this loop().
+
+struct irEvents_t {
+    byte valueChanged;      // Value received on the face changed (same as didValueOnFaceChange())
+    byte arrived;           // A neighbor showed up (the face is no longer expired)
+    byte departed;          // The neighbor went away (the face just expired)
+    byte datagramsReady;    // A datagram is waiting to be read (same as isDatagramReadyOnFace(), so stays set until it is read)
+};
+
+const irEvents_t *getIREvents();
+
 /* --- Datagram processing */
 
 // A datagram is a set of 1-IR_DATAGRAM_MAX_LEN bytes that are atomically sent over the IR link
@@ -80,6 +141,22 @@ void setValueSentOnAllFaces( byte value );
 
 #define IR_DATAGRAM_LEN 16
 
+// How many received datagrams can wait on each face before new ones get dropped. Each extra slot costs
+// IR_DATAGRAM_LEN+1 bytes of RAM per face, so the default is just the one. Set this with a compiler flag
+// (like -DIR_DATAGRAM_RX_SLOTS=4) since blinklib must see the same value as your sketch.
+
+#ifndef IR_DATAGRAM_RX_SLOTS
+    #define IR_DATAGRAM_RX_SLOTS 1
+#endif
+
+// Build with -DBLINKLIB_ZERO_COPY_RX to have received datagrams stay right where the BIOS put them instead of being
+// copied into a buffer in blinklib. This saves IR_DATAGRAM_LEN bytes of RAM per face and the copy, but until you
+// call markDatagramReadOnFace() the BIOS has nowhere to put anything else that comes in on that face, so it gets
+// dropped. That includes face values, so a face can even expire if you hang onto a datagram for too long.
+// Only works with one IR_DATAGRAM_RX_SLOTS.
+
+// These all look at the oldest datagram waiting on the face.
+
 // Returns the number of bytes waiting in the data buffer, or 0 if no packet ready.
 byte getDatagramLengthOnFace( uint8_t face );
 
@@ -95,19 +172,252 @@ const byte *getDatagramOnFace( uint8_t face );
 
 // Frees up the buffer holding the datagram data. Do this as soon as possible after you have
 // processed the datagram to free up the slot for the next incoming datagram on this face.
-// If a new datagram is recieved on a face before markDatagramReadOnFace() is called then
+// After this, the get functions above move on to the next datagram waiting on this face, if any.
+// If a new datagram is recieved on a face when all IR_DATAGRAM_RX_SLOTS are full then
 // the new datagram is siliently discarded. 
 
 void markDatagramReadOnFace( uint8_t face );
 
+// How many outgoing datagrams can wait on each face to be sent. Same RAM cost and same compiler flag
+// rule as IR_DATAGRAM_RX_SLOTS (like -DIR_DATAGRAM_TX_SLOTS=4).
+
+#ifndef IR_DATAGRAM_TX_SLOTS
+    #define IR_DATAGRAM_TX_SLOTS 1
+#endif
+
 // Send a datagram.  
 // Datagram is sent as soon as possible and takes priority over sending a value on face.
-// If you call sendDatagramOnFace() and there is already a pending datagram, the older pending
-// one will be replaced with the new one. 
+// Waiting datagrams go out in order, one per packet.
+//
+// With the default single IR_DATAGRAM_TX_SLOTS, if you call sendDatagramOnFace() and there is
+// already a pending datagram, the older pending one will be replaced with the new one.
+// With more slots (or with BLINKLIB_RELIABLE_DATAGRAMS), the new datagram is instead turned away when they are all full.
+//
+// Returns true if the datagram is now waiting to be sent, false if it was turned away
+// (all slots full, or len>IR_DATAGRAM_LEN) or there was nothing to send (len is 0, which with the default single
+// slot still clears out any pending one like it always has). Check getDatagramSlotsFreeOnFace() first if you
+// want to send a bunch without any getting turned away.
 
 // Note that if the len>IR_DATAGRAM_LEN then packet will never be sent or recieved
 
-void sendDatagramOnFace(  const void *data, byte len , byte face );
+boolean sendDatagramOnFace(  const void *data, byte len , byte face );
+
+// Same as sendDatagramOnFace(), but you build the datagram right where it will be sent from instead of
+// having it copied there. beginDatagramOnFace() returns where to put up to IR_DATAGRAM_LEN bytes (or NULL if
+// sendDatagramOnFace() would have turned it away), then commitDatagramOnFace() sends that many of them.
+// Commit before you begin another one on this face or return from loop(). If you never commit, nothing is sent.
+// Only commit after beginDatagramOnFace() gave you a pointer. commitDatagramOnFace() returns false (and sends
+// nothing) if len is 0 or >IR_DATAGRAM_LEN, or if there was no free slot to commit into because begin returned NULL
+// or was never called.
+
+byte *beginDatagramOnFace( byte face );
+boolean commitDatagramOnFace( byte face , byte len );
+
+// Returns how many send slots on this face are not holding a pending datagram, so how many more datagrams
+// sendDatagramOnFace() will take right now without turning any away. With the default single IR_DATAGRAM_TX_SLOTS
+// (and no BLINKLIB_RELIABLE_DATAGRAMS) this is 0 while one is pending, but sendDatagramOnFace() still takes a new
+// one by replacing the pending one, so 0 here means "you would be replacing something".
+
+byte getDatagramSlotsFreeOnFace( byte face );
+
+// Build with -DBLINKLIB_BROADCAST_DATAGRAMS to be able to send the same datagram out on a bunch of faces at once. blinklib
+// keeps just one copy of it no matter how many faces it is going out on, rather than one in each face's send queue.
+
+#ifdef BLINKLIB_BROADCAST_DATAGRAMS
+
+// Send a datagram on every face with its bit set in faceMask (bit 0 is face 0, so 0b00111111 is all of them).
+// On each face it goes out after any datagrams that were already waiting there, and does not use up any of their slots.
+//
+// There is only one broadcast at a time. If the last one has not gone out on all of its faces yet, the new one replaces it
+// on the faces it has not gotten to (or with more IR_DATAGRAM_TX_SLOTS or BLINKLIB_RELIABLE_DATAGRAMS, is turned away).
+//
+// With BLINKLIB_RELIABLE_DATAGRAMS it waits on each face until the neighbor there takes it, except that a face
+// with nobody on it for a second is let go so it does not hold up the rest.
+//
+// Returns true if the datagram is now waiting to be sent, false if it was turned away (or len is 0 or >IR_DATAGRAM_LEN,
+// or faceMask does not have any of the 6 faces in it).
+
+boolean sendDatagramOnFaces( const void *data , byte len , byte faceMask );
+
+// Returns a bit for each face the broadcast datagram has not gone out on yet (or in reliable mode, been acked on)
+
+byte getDatagramFacesPending();
+
+#endif
+
+/* --- Messages */
+
+// Build with -DBLINKLIB_MESSAGES to be able to send messages of up to IR_MESSAGE_MAX_LEN bytes, which is more than fits in
+// a datagram. blinklib splits a message into fragments that use as much of each IR packet as it can, sends them
+// one after another, and puts them back together on the other side. Datagrams waiting to be sent go first.
+//
+// To save RAM, blinklib does not keep its own copy of a message, so you have to supply the buffers.
+// With BLINKLIB_RELIABLE_DATAGRAMS, fragments get the same exactly-once delivery as datagrams.
+// Without it, a message with a lost fragment is dropped.
+
+#define IR_MESSAGE_MAX_LEN 256
+
+#ifdef BLINKLIB_MESSAGES
+
+// Start sending a message on the indicated face. The data is not copied, so leave it alone until
+// isMessageSendingOnFace() goes false. Returns false (and sends nothing) if a message is already
+// being sent on this face or if len is 0 or bigger than IR_MESSAGE_MAX_LEN.
+
+boolean sendMessageOnFace( const void *data , word len , byte face );
+
+// Returns true while a message is still going out on this face
+
+boolean isMessageSendingOnFace( byte face );
+
+// Incoming messages on this face are put together in this buffer, which must stay around. Messages
+// longer than `size` are dropped. Pass NULL to stop taking messages on this face (this is the default).
+
+void setMessageBufferOnFace( byte face , void *buffer , word size );
+
+// Returns true once a whole message has arrived in the buffer for this face
+
+boolean isMessageReadyOnFace( byte face );
+
+// Returns the length of the message waiting in the buffer for this face, or 0 if none yet
+
+word getMessageLengthOnFace( byte face );
+
+// Lets the next message come into the buffer. Until you do this, new messages on this face
+// are dropped (or with BLINKLIB_RELIABLE_DATAGRAMS, held up on the sender).
+
+void markMessageReadOnFace( byte face );
+
+#endif
+
+/* --- Reliable datagrams */
+
+// Build with -DBLINKLIB_RELIABLE_DATAGRAMS to have blinklib make sure every datagram gets to the other side exactly once.
+//
+// Each datagram carries a sequence bit, and every packet going back the other way (datagram or face value) carries
+// an acknowledgement. A datagram stays at the front of the send queue and gets sent again every time we get to send on
+// that face until the neighbor acknowledges it. The neighbor only acknowledges a datagram once it has a free receive
+// slot to put it in, so a slow reader just slows the sender down rather than losing anything.
+//
+// This changes what goes over the air (face value packets get one more byte), so every tile in the cluster
+// must be built with it. When a neighbor shows up on a face that has been quiet for a second, the sequence starts over.
+// (So if you swap one neighbor for another faster than that, the first datagram could get lost or taken twice.)
+
+/* --- Datagram checksums */
+
+// Every datagram (and message fragment) ends with a check byte. By default that is a plain sum, which is cheap but
+// can not tell when two bytes got swapped and misses a lot of burst errors.
+//
+// Build with -DBLINKLIB_CRC8_DATAGRAMS to use a CRC-8 instead. It catches any odd number of flipped bits and any burst of
+// up to 8 flipped bits, and only lets about 1 in 256 of everything else though, so you should not need checks of your
+// own on top. It is looked up in a 256 byte table in flash. Also build with -DBLINKLIB_CRC8_NIBBLE_TABLE to use a 16 byte
+// table instead, which saves 240 bytes of flash but is slower (about 3.5 times as long per byte in `make bench` on the host).
+//
+// Like BLINKLIB_RELIABLE_DATAGRAMS, this changes what goes over the air, so every tile in the cluster must be built with it.
+
+/* --- Forward error correction */
+
+// Build with -DBLINKLIB_FEC_DATAGRAMS to send every byte of a datagram (or message fragment) as two bytes of Hamming code
+// so that the other side can fix a flipped bit in each half rather than throwing the whole thing away and waiting for
+// it to come again. This helps in bright rooms or with tiles that are not quite lined up, where a lot of datagrams
+// fail the checksum. Datagrams take about twice as long to send, message fragments only hold half as much, and the
+// code tables take 272 bytes of flash. Face values go out the same as always.
+//
+// Like BLINKLIB_RELIABLE_DATAGRAMS, this changes what goes over the air, so every tile in the cluster must be built with it.
+
+/* --- Carrier sense */
+
+// Build with -DBLINKLIB_CARRIER_SENSE to have blinklib check if the neighbor is in the middle of sending to us before it sends
+// on a face, and if so, hold off for a random few milliseconds instead of sending into it. Probes on faces with nobody
+// answering also go out at random times rather than on a fixed schedule, so two tiles whose packets crashed into each
+// other do not keep crashing every probe after that. This does not change what goes over the air.
+
+/* --- Probe timing */
+
+// When nothing comes in on a face, blinklib sends on it every 150ms anyway to see if anyone is there (and to get things
+// going again if a packet got lost). Build with -DBLINKLIB_ADAPTIVE_PROBE to have that time change with what is going on:
+//
+// * A face with a datagram or message waiting to go out, or whose value just changed, probes sooner (TX_PROBE_BUSY_MS)
+//   so a lost packet holds things up less.
+// * A face with nobody there probes half as often each time, up to TX_PROBE_IDLE_MAX_MS, which saves power when tiles
+//   sit alone. The catch is that a new neighbor can take up to that long to show up on that face.
+//
+// Or build with -DBLINKLIB_PROBE_LOW_LATENCY (20ms busy, 300ms idle) or BLINKLIB_PROBE_LOW_POWER (100ms busy, 1200ms idle)
+// to get it with those settings rather than the default 50ms and 600ms. This does not change what goes over the air.
+
+#if defined( BLINKLIB_PROBE_LOW_LATENCY ) || defined( BLINKLIB_PROBE_LOW_POWER )
+    #define BLINKLIB_ADAPTIVE_PROBE
+#endif
+
+/* --- Wide face values */
+
+// Build with -DBLINKLIB_WIDE_VALUES to send a 16 bit value on each face instead of a 6 bit one, so you can keep more of your
+// game state on the face value rather than sending datagrams back and forth. A face value packet is then 4 bytes
+// instead of 1 (a header byte, the two bytes of value, and a checksum, so it is also better protected than the
+// parity bit on a plain face value), which makes the ping-pong on each face a bit slower.
+//
+// The plain face value functions still work, they just see the low 6 bits of the wide value. A neighbor built without
+// this can still talk to you, and its value shows up as a wide value between 0 and IR_DATA_VALUE_MAX, but it will
+// not understand your wide values. didValueOnFaceChange() and getIREvents() tell you when any of the 16 bits change.
+
+#ifdef BLINKLIB_WIDE_VALUES
+
+    // Returns the last received wide value on the indicated face, or 0 if no neighbor ever seen since power-up
+
+    uint16_t getWideValueReceivedOnFace( byte face );
+
+    // Set the wide value that will be continuously sent on the face (or on all faces). setValueSentOnFace() sets it too.
+
+    void setWideValueSentOnFace( uint16_t value , byte face );
+    void setWideValueSentOnAllFaces( uint16_t value );
+
+#endif
+
+/* --- Face values on datagrams */
+
+// While a face is busy sending datagrams (or messages), they go out instead of the face value, so the neighbor does not
+// see our value change until we are done. Build with -DBLINKLIB_DATAGRAM_VALUES to have every datagram carry the face value
+// too (one more byte, or two with BLINKLIB_WIDE_VALUES), so games that go by face values keep up while the data flows.
+// The room comes out of each message fragment.
+//
+// Like BLINKLIB_RELIABLE_DATAGRAMS, this changes what goes over the air, so every tile in the cluster must be built with it.
+//
+// You can not have this together with BLINKLIB_WIDE_VALUES, BLINKLIB_RELIABLE_DATAGRAMS, and BLINKLIB_FEC_DATAGRAMS all
+// at once. With all four, a full IR_DATAGRAM_LEN datagram plus the link byte and the two value bytes, all doubled
+// by FEC, is bigger than a BIOS packet, so the build stops with an #error. Any three of them are fine.
+
+/* --- Link statistics */
+
+// Build with -DBLINKLIB_LINK_STATS to have blinklib count what happens to every packet on each face.
+// Costs 96 bytes of RAM (108 with BLINKLIB_FEC_DATAGRAMS), so off by default. Counters wrap at 65535.
+
+#ifdef BLINKLIB_LINK_STATS
+
+struct linkStats_t {
+    uint16_t packetsReceived;           // Every packet the BIOS handed us on this face, good or bad
+    uint16_t nonUserPackets;            // Packets that were not user data (some other BIOS packet type), ignored
+    uint16_t parityErrors;              // Header byte failed the parity check, ignored
+    uint16_t checksumErrors;            // Datagrams that failed the checksum, ignored
+    uint16_t datagramsDroppedFull;      // Good datagrams that arrived before markDatagramReadOnFace() freed the buffer
+    uint16_t datagramsDroppedOversize;  // Good datagrams that were longer than IR_DATAGRAM_LEN
+    uint16_t sendsRejected;             // Times the BIOS could not send because something was coming in on this face (we try again next pass, or with BLINKLIB_CARRIER_SENSE after a backoff)
+    uint16_t datagramsOverwritten;      // Times sendDatagramOnFace() replaced a datagram that had not gone out yet (or turned one away because all IR_DATAGRAM_TX_SLOTS were full)
+    #ifdef BLINKLIB_FEC_DATAGRAMS
+    uint16_t bitsCorrected;             // Flipped bits that forward error correction fixed
+    #endif
+    #ifdef BLINKLIB_CARRIER_SENSE
+    uint16_t sendsDeferred;             // Times we held off sending because we could see something coming in on this face already (not counted in sendsRejected)
+    #endif
+};
+
+// Returns the counters for the indicated face. They keep counting, so read what you need right away.
+
+const linkStats_t *getLinkStats( byte face );
+
+// Set all the counters for the indicated face back to 0
+
+void resetLinkStats( byte face );
+
+#endif
 
 
 /*
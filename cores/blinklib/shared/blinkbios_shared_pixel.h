@@ -48,9 +48,12 @@ const rawpixel_t RAW_PIXEL_OFF( 0xff , 0xff, 0xff );
 // Note use of anonymous union members to let us switch between bitfield and int
 // https://stackoverflow.com/questions/2468708/converting-bit-field-to-int
 
+// The `packed` is a no-op on AVR, but without it other compilers will not let the 5 bit fields
+// straddle byte boundaries and the color would no longer fit in `as_uint16` (see `/host`).
+
 union pixelColor_t {
 
-    struct {
+    struct __attribute__((packed)) {
         uint8_t reserved:1;
         uint8_t r:5;
         uint8_t g:5;
@@ -0,0 +1,15 @@
+/*
+ * Host stand-in for <avr/interrupt.h>
+ *
+ * The emulated BIOS only ever runs when the tile yields to it (see blinkbios_host.cpp),
+ * so the foreground can never be interrupted and these are no-ops.
+ *
+ */
+
+#ifndef HOST_AVR_INTERRUPT_H_
+#define HOST_AVR_INTERRUPT_H_
+
+#define cli()
+#define sei()
+
+#endif /* HOST_AVR_INTERRUPT_H_ */
@@ -0,0 +1,22 @@
+/*
+ * Host stand-in for <avr/io.h>
+ *
+ * We only define the handful of registers that blinklib touches directly. They are
+ * plain variables that the emulated BIOS looks at when the tile yields.
+ *
+ */
+
+#ifndef HOST_AVR_IO_H_
+#define HOST_AVR_IO_H_
+
+#include <stdint.h>
+
+#define _BV(bit) (1 << (bit))
+
+// Watchdog Timer Control Register. Used by randomize() to get entropy out of the WDT ISR.
+
+#define WDIE 6
+
+extern volatile uint8_t WDTCSR;
+
+#endif /* HOST_AVR_IO_H_ */
@@ -0,0 +1,27 @@
+/*
+ * Host stand-in for <avr/pgmspace.h>
+ *
+ * On the host there is only one address space, so PROGMEM is just plain const memory
+ * and the pgm_read_*() accessors are just dereferences.
+ *
+ */
+
+#ifndef HOST_AVR_PGMSPACE_H_
+#define HOST_AVR_PGMSPACE_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+
+#define PGM_P const char *
+#define PSTR(s) (s)
+
+#define pgm_read_byte(addr)     (*(const uint8_t  *)(addr))
+#define pgm_read_word(addr)     (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr)    (*(const uint32_t *)(addr))
+
+#define strlen_P(s)             strlen(s)
+#define memcpy_P(d,s,n)         memcpy((d),(s),(n))
+
+#endif /* HOST_AVR_PGMSPACE_H_ */
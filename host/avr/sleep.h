@@ -0,0 +1,11 @@
+/*
+ * Host stand-in for <avr/sleep.h>
+ *
+ */
+
+#ifndef HOST_AVR_SLEEP_H_
+#define HOST_AVR_SLEEP_H_
+
+#define sleep_cpu()
+
+#endif /* HOST_AVR_SLEEP_H_ */
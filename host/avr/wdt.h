@@ -0,0 +1,13 @@
+/*
+ * Host stand-in for <avr/wdt.h>
+ *
+ */
+
+#ifndef HOST_AVR_WDT_H_
+#define HOST_AVR_WDT_H_
+
+#include "io.h"
+
+#define wdt_disable() (WDTCSR = 0)
+
+#endif /* HOST_AVR_WDT_H_ */
@@ -0,0 +1,363 @@
+/*
+ * bench.cpp
+ *
+ * Times the little codec functions in blinklib that run on every IR packet, on the host.
+ *
+ * blinklib.cpp is #included right into this file so that we can call its static functions directly, with whatever
+ * BLINKLIB_* flags this file was compiled with. Each function gets run over a buffer of random bytes many times over
+ * and we report the best of a few runs in nanoseconds per call.
+ *
+ * These are host numbers, so they only tell you how one way of doing something compares to another on the same computer,
+ * not how many cycles something takes on a tile.
+ *
+ * Every benchmark also checks that the new code gives the same answers as the code it replaced (or a plain bit at a
+ * time version of the same thing), and we exit with 1 if not.
+ *
+ * Usage: bench [-n iterations] [parity] [checksum] [fec]
+ *
+ *  -n  How many times to go though the buffer in each run (default 20000)
+ *
+ * Runs just the named benchmarks, or all of them if none are named:
+ *
+ *  parity      Header byte parity in irValueEncode() and irValueCheckValid()
+ *  checksum    computePacketChecksum(), which is whichever of the sum, CRC-8, or CRC-8 nibble table we were built with
+ *  fec         fecEncode() and fecDecode(), if built with BLINKLIB_FEC_DATAGRAMS
+ *
+ */
+
+#include "blinklib.cpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+// blinklib.cpp calls these from run(), which we never call
+
+void setup() {}
+void loop() {}
+
+#define BENCH_BUFFER_LEN    256
+#define BENCH_RUNS          5
+
+static uint8_t buffer[ BENCH_BUFFER_LEN ];
+
+static uint32_t iterations = 20000;
+
+// Keeps the compiler from throwing away work whose answer nobody looks at
+
+static volatile uint8_t sink;
+
+static int failures;
+
+static double host_seconds() {
+
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC , &ts );
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+
+}
+
+// Best time in nanoseconds that `f` took for each of `count` things it did per pass over the buffer
+
+template <typename F> static double best_ns( F f , uint32_t count ) {
+
+    double best = 0;
+
+    for( int run = 0 ; run < BENCH_RUNS ; run++ ) {
+
+        double start = host_seconds();
+
+        uint8_t x = 0;
+
+        for( uint32_t i = 0 ; i < iterations ; i++ ) {
+            x ^= f();
+        }
+
+        double elapsed = host_seconds() - start;
+
+        sink = x;
+
+        if ( run == 0 || elapsed < best ) {
+            best = elapsed;
+        }
+
+    }
+
+    return best * 1e9 / ( (double) iterations * count );
+
+}
+
+static void check( const char *what , bool ok ) {
+
+    if ( !ok ) {
+        printf( "MISMATCH: %s\n" , what );
+        failures++;
+    }
+
+}
+
+// --- Header byte parity
+
+// This is how irValueEncode() and irValueCheckValid() used to work, one bit at a time
+
+static uint8_t oldOddParity( uint8_t d ) {
+
+    uint8_t bits=0;
+
+    while (d) {
+
+        if (d & 0b00000001 ) {
+            bits++;
+        }
+
+        d >>=1;
+
+    }
+
+    return bits & 0b00000001;
+
+}
+
+static uint8_t oldIrValueEncode( uint8_t d , uint8_t postponeSleepFlag ) {
+
+    if (postponeSleepFlag) {
+        d |= 0b01000000;
+    }
+
+    if ( !oldOddParity( d )) {
+        d |= 0b10000000;
+    }
+
+    return d;
+
+}
+
+static uint8_t oldIrValueCheckValid( uint8_t d ) {
+
+    return oldOddParity( d );
+
+}
+
+static void bench_parity() {
+
+    for( uint8_t d = 0 ; d <= IR_DATA_VALUE_MAX ; d++ ) {
+        check( "irValueEncode()" , irValueEncode( d , 0 ) == oldIrValueEncode( d , 0 ) && irValueEncode( d , 1 ) == oldIrValueEncode( d , 1 ) );
+    }
+
+    for( int d = 0 ; d < 256 ; d++ ) {
+        check( "irValueCheckValid()" , !irValueCheckValid( d ) == !oldIrValueCheckValid( d ) );
+    }
+
+    // Values only go up to IR_DATA_VALUE_MAX, so mask the random bytes down to that for encoding
+
+    double oldEncode = best_ns( []() { uint8_t x = 0; for( int i = 0 ; i < BENCH_BUFFER_LEN ; i++ ) x ^= oldIrValueEncode( buffer[i] & IR_DATA_VALUE_MAX , i & 1 ); return x; } , BENCH_BUFFER_LEN );
+    double newEncode = best_ns( []() { uint8_t x = 0; for( int i = 0 ; i < BENCH_BUFFER_LEN ; i++ ) x ^= irValueEncode( buffer[i] & IR_DATA_VALUE_MAX , i & 1 ); return x; } , BENCH_BUFFER_LEN );
+
+    double oldCheck = best_ns( []() { uint8_t x = 0; for( int i = 0 ; i < BENCH_BUFFER_LEN ; i++ ) x ^= oldIrValueCheckValid( buffer[i] ); return x; } , BENCH_BUFFER_LEN );
+    double newCheck = best_ns( []() { uint8_t x = 0; for( int i = 0 ; i < BENCH_BUFFER_LEN ; i++ ) x ^= irValueCheckValid( buffer[i] ); return x; } , BENCH_BUFFER_LEN );
+
+    printf( "%-28s %12s %12s\n" , "header parity (ns/call)" , "bit loop" , "nibble table" );
+    printf( "%-28s %12.2f %12.2f\n" , "irValueEncode()" , oldEncode , newEncode );
+    printf( "%-28s %12.2f %12.2f\n" , "irValueCheckValid()" , oldCheck , newCheck );
+
+}
+
+// --- Datagram checksum
+
+// The same thing computePacketChecksum() works out, done the slow and obvious way
+
+static uint8_t referenceChecksum( const uint8_t *buffer , uint8_t len ) {
+
+    #ifdef BLINKLIB_CRC8_DATAGRAMS
+
+        uint8_t crc = CRC8_INIT;
+
+        for( uint8_t l = 0 ; l < len ; l++ ) {
+
+            crc ^= buffer[l];
+
+            for( uint8_t bit = 0 ; bit < 8 ; bit++ ) {
+                crc = ( crc & 0x80 ) ? ( crc << 1 ) ^ 0x07 : ( crc << 1 );
+            }
+
+        }
+
+        return crc;
+
+    #else
+
+        uint8_t sum = 0;
+
+        for( uint8_t l = 0 ; l < len ; l++ ) {
+            sum += buffer[l];
+        }
+
+        return sum ^ 0xff;
+
+    #endif
+
+}
+
+static void bench_checksum() {
+
+    for( int start = 0 ; start < BENCH_BUFFER_LEN ; start += IR_DATAGRAM_LEN ) {
+        for( uint8_t len = 0 ; len <= IR_DATAGRAM_LEN ; len++ ) {
+            check( "computePacketChecksum()" , computePacketChecksum( buffer + start , len ) == referenceChecksum( buffer + start , len ) );
+        }
+    }
+
+    // A full datagram at a time, since that is the most we ever check at once
+
+    double perByte = best_ns( []() { uint8_t x = 0; for( int i = 0 ; i < BENCH_BUFFER_LEN ; i += IR_DATAGRAM_LEN ) x ^= computePacketChecksum( buffer + i , IR_DATAGRAM_LEN ); return x; } , BENCH_BUFFER_LEN );
+
+    #if defined( BLINKLIB_CRC8_NIBBLE_TABLE )
+        const char *name = "crc8 nibble table";
+    #elif defined( BLINKLIB_CRC8_DATAGRAMS )
+        const char *name = "crc8 256 byte table";
+    #else
+        const char *name = "sum";
+    #endif
+
+    printf( "%-28s %12s %12s\n" , "computePacketChecksum()" , "ns/byte" , "ns/datagram" );
+    printf( "%-28s %12.2f %12.2f\n" , name , perByte , perByte * IR_DATAGRAM_LEN );
+
+}
+
+// --- Forward error correction
+
+#ifdef BLINKLIB_FEC_DATAGRAMS
+
+static uint8_t codeBuffer[ 2 * BENCH_BUFFER_LEN ];
+
+static void bench_fec() {
+
+    // Every byte must come back the same, with any one bit in either code byte flipped, and any two bits flipped in
+    // the same code byte must be caught
+
+    for( int b = 0 ; b < 256 ; b++ ) {
+
+        uint8_t data = b;
+        uint8_t code[2];
+
+        fecEncode( code , &data , 1 );
+
+        for( int flip1 = -1 ; flip1 < 16 ; flip1++ ) {
+
+            for( int flip2 = flip1 ; flip2 < 16 ; flip2++ ) {
+
+                uint8_t bent[2] = { code[0] , code[1] };
+
+                if ( flip1 >= 0 ) bent[ flip1 / 8 ] ^= 1 << ( flip1 % 8 );
+                if ( flip2 >= 0 && flip2 != flip1 ) bent[ flip2 / 8 ] ^= 1 << ( flip2 % 8 );
+
+                bool twoInOne = flip1 >= 0 && flip2 != flip1 && flip1 / 8 == flip2 / 8;
+                bool fixable = flip1 < 0 || flip2 == flip1 || !twoInOne;
+
+                boolean good = fecDecode( 0 , bent , 2 );
+
+                if ( fixable ) {
+                    check( "fecDecode() fixing a bit" , good && bent[0] == b );
+                } else {
+                    check( "fecDecode() catching two bits" , !good );
+                }
+
+            }
+
+        }
+
+    }
+
+    // A full datagram at a time like the checksum. fecDecode() works in place, so each time it gets a fresh copy of
+    // the code bytes, and that copy counts against it.
+
+    double encode = best_ns( []() { uint8_t x = 0; for( int i = 0 ; i < BENCH_BUFFER_LEN ; i += IR_DATAGRAM_LEN ) x ^= fecEncode( codeBuffer + 2 * i , buffer + i , IR_DATAGRAM_LEN ); return x; } , BENCH_BUFFER_LEN );
+
+    static uint8_t scratch[ 2 * BENCH_BUFFER_LEN ];
+
+    double decode = best_ns( []() { uint8_t x = 0; memcpy( scratch , codeBuffer , sizeof( scratch ) ); for( int i = 0 ; i < BENCH_BUFFER_LEN ; i += IR_DATAGRAM_LEN ) x ^= fecDecode( 0 , scratch + 2 * i , 2 * IR_DATAGRAM_LEN ); return x; } , BENCH_BUFFER_LEN );
+
+    for( int i = 0 ; i < BENCH_BUFFER_LEN ; i += IR_DATAGRAM_LEN ) {
+        check( "fecDecode() of fecEncode()" , memcmp( scratch + 2 * i , buffer + i , IR_DATAGRAM_LEN ) == 0 );
+    }
+
+    printf( "%-28s %12s\n" , "forward error correction" , "ns/byte" );
+    printf( "%-28s %12.2f\n" , "fecEncode()" , encode );
+    printf( "%-28s %12.2f\n" , "fecDecode()" , decode );
+
+}
+
+#endif
+
+int main( int argc , char **argv ) {
+
+    int opt;
+
+    while ( (opt = getopt( argc , argv , "n:" )) != -1 ) {
+
+        switch (opt) {
+
+            case 'n':
+                iterations = strtoul( optarg , NULL , 0 );
+                break;
+
+            default:
+                fprintf( stderr , "Usage: %s [-n iterations] [parity] [checksum] [fec]\n" , argv[0] );
+                return 1;
+        }
+
+    }
+
+    if ( iterations == 0 ) iterations = 1;
+
+    // Same bytes every time so runs can be compared
+
+    srand( 1 );
+
+    for( int i = 0 ; i < BENCH_BUFFER_LEN ; i++ ) {
+        buffer[i] = rand();
+    }
+
+    bool all = optind == argc;
+
+    for( int i = optind ; i < argc ; i++ ) {
+
+        if ( strcmp( argv[i] , "parity" ) && strcmp( argv[i] , "checksum" ) && strcmp( argv[i] , "fec" ) ) {
+            fprintf( stderr , "No benchmark called %s\n" , argv[i] );
+            return 1;
+        }
+
+    }
+
+    auto wanted = [&]( const char *name ) {
+
+        if ( all ) return true;
+
+        for( int i = optind ; i < argc ; i++ ) {
+            if ( !strcmp( argv[i] , name ) ) return true;
+        }
+
+        return false;
+    };
+
+    if ( wanted( "parity" ) ) {
+        bench_parity();
+    }
+
+    if ( wanted( "checksum" ) ) {
+        bench_checksum();
+    }
+
+    if ( wanted( "fec" ) ) {
+
+        #ifdef BLINKLIB_FEC_DATAGRAMS
+            bench_fec();
+        #else
+            if ( !all ) fprintf( stderr , "Build with -DBLINKLIB_FEC_DATAGRAMS for the fec benchmark\n" );
+        #endif
+
+    }
+
+    return failures ? 1 : 0;
+}
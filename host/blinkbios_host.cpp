@@ -0,0 +1,539 @@
+/*
+ * blinkbios_host.cpp
+ *
+ * An emulated BlinkBIOS so that blinklib and unmodified sketches can run natively on a host computer.
+ *
+ * This gets linked into the tile image right alongside blinklib and the sketch. It provides...
+ *
+ * 1. The four shared memory blocks that `main.cpp` normally places in `.ipcram1`-`.ipcram4`.
+ * 2. The `boot_vectorN` entry points that blinklib normally jumps to up in the bootloader.
+ * 3. The background work the BIOS normally does from its ISRs (millis, button debounce & clicks, sleep),
+ *    which here only happens when the driver calls blinkbios_host_advance().
+ *
+ * The foreground runs as a coroutine on its own stack. Every call into BLINKBIOS_DISPLAY_PIXEL_BUFFER_VECTOR()
+ * (and every BLINKBIOS_SPIN_YIELD() ) switches back to the driver, so a tile always stops at a well defined point.
+ *
+ * Note that everything here is deliberately kept in plain static variables so that the entire state of a
+ * tile lives in the writable data of the image. That is what lets a driver swap tiles in and out.
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <ucontext.h>
+
+#include "shared/blinkbios_shared_button.h"
+#include "shared/blinkbios_shared_millis.h"
+#include "shared/blinkbios_shared_pixel.h"
+#include "shared/blinkbios_shared_irdata.h"
+
+#include "shared/blinkbios_shared_functions.h"
+
+#include "run.h"
+
+#include "blinkbios_host.h"
+
+#include "avr/io.h"
+
+// Here are the actual allocations for the shared memory blocks. On a tile these are in `main.cpp`.
+
+blinkbios_pixelblock_t      blinkbios_pixel_block;
+blinkbios_millis_block_t    blinkbios_millis_block;
+blinkbios_button_block_t    blinkbios_button_block;
+blinkbios_irdata_block_t    blinkbios_irdata_block;
+
+// Stand-ins for the hardware bits blinklib touches directly
+
+volatile uint8_t WDTCSR;
+
+uint8_t blinkbios_host_serialno[ 9 ];
+
+#define BLINKBIOS_HOST_VERSION          99      // Reported by BLINKBIOS_VERSION_VECTOR so you can tell you are on the host
+
+// Button timing. These match the thresholds that blinklib documents.
+
+#define BUTTON_DEBOUNCE_MS              20
+#define BUTTON_CLICK_WINDOW_MS          330     // A click must follow the previous release by less than this to count
+#define BUTTON_LONGPRESS_MS             2000
+#define BUTTON_SEED_PRESS_MS            6000    // Sets BUTTON_BITFLAG_3SECPRESSED
+#define BUTTON_SLEEP_PRESS_MS           7000    // Sets BUTTON_BITFLAG_6SECPRESSED
+
+static blinkbios_host_env_t host_env;
+
+static ucontext_t bios_context;         // Where the driver is waiting while the foreground runs
+static ucontext_t tile_context;         // Where the foreground is waiting while the driver runs
+
+static uint8_t step_reason;             // Why the foreground last yielded (BLINKBIOS_HOST_STEP_*)
+static uint8_t stopped_reason;          // Non-zero if the foreground will never run again
+
+static uint8_t cold_sleep_flag;         // 1 if the BIOS has put us into cold sleep
+
+static uint8_t physical_button_down;    // What the button is actually doing, before debounce
+
+static uint32_t wake_hint;              // Earliest future BLINKBIOS_WAKE_HINT() from the foreground, or BLINKBIOS_HOST_NEVER
+static uint8_t wake_hinted_flag;        // Did the foreground give any hints at all during the last step?
+
+// Generator for the entropy the BIOS WDT ISR captures for randomize()
+
+static uint32_t entropy_state;
+
+static uint8_t next_entropy() {
+    uint32_t x = entropy_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    entropy_state = x;
+    return (uint8_t) x;
+}
+
+// Give control back to the driver
+
+static void yield_to_bios( uint8_t reason ) {
+
+    step_reason = reason;
+    swapcontext( &tile_context , &bios_context );
+
+}
+
+// Park the foreground forever. Used for the vectors that never return.
+
+static void __attribute__((noreturn)) stop_foreground( uint8_t reason ) {
+
+    stopped_reason = reason;
+
+    while (1) {
+        yield_to_bios( reason );
+    }
+
+}
+
+static void foreground_entry() {
+
+    run();
+
+}
+
+// --- Vectors
+
+extern "C" uint8_t BLINKBIOS_IRDATA_SEND_PACKET_VECTOR(  uint8_t face, const uint8_t *data , uint8_t len ) {
+
+    if ( blinkbios_is_rx_in_progress( face ) ) {
+        return 0;
+    }
+
+    if ( !host_env.ir_send ) {
+        return 1;           // Nobody out there, so it went out into the void
+    }
+
+    return host_env.ir_send( host_env.context , face , data , len );
+
+}
+
+extern "C" void BLINKBIOS_DISPLAY_PIXEL_BUFFER_VECTOR() {
+
+    // A real BIOS waits here for the next vertical retrace, which is the end of a frame
+
+    blinkbios_pixel_block.vertical_blanking_interval = 0;
+
+    yield_to_bios( BLINKBIOS_HOST_STEP_FRAME );
+
+}
+
+extern "C" void BLINKBIOS_BOOTLOADER_SEED_VECTOR() {
+
+    stop_foreground( BLINKBIOS_HOST_STEP_SEED );
+
+}
+
+extern "C" void BLINKBIOS_POSTPONE_SLEEP_VECTOR() {
+
+    blinkbios_millis_block.sleep_time = blinkbios_millis_block.millis + BLINKBIOS_HOST_SLEEP_TIMEOUT_MS;
+
+}
+
+extern "C" void BLINKBIOS_SLEEP_NOW_VECTOR() {
+
+    cold_sleep_flag = 1;
+
+    // We will not get back here until the button wakes us
+
+    yield_to_bios( BLINKBIOS_HOST_STEP_SLEEP );
+
+}
+
+extern "C" void BLINKBIOS_WRITE_FLASH_PAGE_VECTOR(uint8_t page) {
+
+    // There is no flash to write
+
+    (void) page;
+
+}
+
+extern "C" uint8_t BLINKBIOS_VERSION_VECTOR() {
+
+    return BLINKBIOS_HOST_VERSION;
+
+}
+
+extern "C" void BLINKBIOS_ABEND_VECTOR( uint8_t blinkCount ) {
+
+    (void) blinkCount;
+
+    stop_foreground( BLINKBIOS_HOST_STEP_ABEND );
+
+}
+
+extern "C" void blinkbios_host_spin( void ) {
+
+    yield_to_bios( BLINKBIOS_HOST_STEP_SPIN );
+
+}
+
+// Called by blinklib with BLINKBIOS_WAKE_HINT(). We only need to remember the earliest one because the foreground
+// repeats the hints it still cares about every time it checks on them.
+
+extern "C" void blinkbios_host_wake_hint( uint32_t millis ) {
+
+    wake_hinted_flag = 1;
+
+    if ( millis > blinkbios_millis_block.millis && millis < wake_hint ) {
+        wake_hint = millis;
+    }
+
+}
+
+// Called by the host service port code in sp_host.cpp
+
+extern "C" void blinkbios_host_sp_tx( uint8_t b ) {
+
+    if ( host_env.sp_tx ) {
+        host_env.sp_tx( host_env.context , b );
+    }
+
+}
+
+// --- Background
+
+static void button_tick() {
+
+    blinkbios_button_block_t *b = &blinkbios_button_block;
+
+    if ( b->buttonDebounceCountdown ) {
+
+        b->buttonDebounceCountdown--;
+
+    } else if ( physical_button_down != b->down ) {
+
+        b->down = physical_button_down;
+        b->buttonDebounceCountdown = BUTTON_DEBOUNCE_MS;
+
+        if ( b->down ) {
+
+            b->bitflags |= BUTTON_BITFLAG_PRESSED;
+
+            b->pressCountup = 0;
+            b->longpressRegisteredFlag = 0;
+
+            if ( b->clickPendingcount < 255 ) {
+                b->clickPendingcount++;
+            }
+
+            BLINKBIOS_POSTPONE_SLEEP_VECTOR();
+
+        } else {
+
+            b->bitflags |= BUTTON_BITFLAG_RELEASED;
+
+            if ( b->longpressRegisteredFlag ) {
+
+                // Held too long, so this is not a click
+
+                b->clickPendingcount = 0;
+
+            }
+
+        }
+
+        b->clickWindowCountdown = BUTTON_CLICK_WINDOW_MS;
+
+    }
+
+    if ( b->down ) {
+
+        if ( b->pressCountup < BUTTON_SLEEP_PRESS_MS ) {
+
+            b->pressCountup++;
+
+            switch ( b->pressCountup ) {
+
+                case BUTTON_LONGPRESS_MS:
+                    b->bitflags |= BUTTON_BITFLAG_LONGPRESSED;
+                    b->longpressRegisteredFlag = 1;
+                    b->clickPendingcount = 0;
+                    break;
+
+                case BUTTON_SEED_PRESS_MS:
+                    b->bitflags |= BUTTON_BITFLAG_3SECPRESSED;
+                    break;
+
+                case BUTTON_SLEEP_PRESS_MS:
+                    b->bitflags |= BUTTON_BITFLAG_6SECPRESSED;
+                    break;
+
+            }
+
+        }
+
+    } else if ( b->clickWindowCountdown ) {
+
+        b->clickWindowCountdown--;
+
+        if ( b->clickWindowCountdown == 0 && b->clickPendingcount ) {
+
+            switch ( b->clickPendingcount ) {
+
+                case 1:
+                    b->bitflags |= BUTTON_BITFLAG_SINGLECLICKED;
+                    break;
+
+                case 2:
+                    b->bitflags |= BUTTON_BITFLAG_DOUBLECLICKED;
+                    break;
+
+                default:
+                    b->bitflags |= BUTTON_BITFLAG_MULITCLICKED;
+                    break;
+
+            }
+
+            b->clickcount = b->clickPendingcount;
+            b->clickPendingcount = 0;
+
+        }
+
+    }
+
+}
+
+// Everything the BIOS does in one millisecond worth of ISRs
+
+static void bios_tick() {
+
+    if ( cold_sleep_flag ) {
+
+        // The clock does not run while we are asleep. Only a button press can wake us.
+
+        if ( physical_button_down ) {
+
+            cold_sleep_flag = 0;
+            blinkbios_button_block.wokeFlag = 0;
+            BLINKBIOS_POSTPONE_SLEEP_VECTOR();
+
+        }
+
+        return;
+    }
+
+    blinkbios_millis_block.millis++;
+    blinkbios_millis_block.step_8us = 0;
+
+    button_tick();
+
+    // The pixel refresh ISR sets this. We call the refresh complete at every millisecond boundary.
+
+    blinkbios_pixel_block.vertical_blanking_interval = 1;
+
+    if ( WDTCSR & _BV( WDIE ) ) {
+
+        // The WDT ISR grabs the current value of TCNT0
+
+        blinkbios_pixel_block.capturedEntropy = next_entropy();
+
+    }
+
+    if ( blinkbios_millis_block.millis > blinkbios_millis_block.sleep_time ) {
+
+        cold_sleep_flag = 1;
+
+    }
+
+}
+
+// True if nothing is going on with the button, so a tick would not do anything to it
+
+static uint8_t button_idle() {
+
+    const blinkbios_button_block_t *b = &blinkbios_button_block;
+
+    return !physical_button_down && !b->down && !b->buttonDebounceCountdown && !b->clickWindowCountdown;
+
+}
+
+// --- Driver interface
+
+void blinkbios_host_boot( const blinkbios_host_env_t *env , void *stack , size_t stack_size ) {
+
+    host_env = *env;
+
+    entropy_state = env->seed ? env->seed : 1;
+
+    for( uint8_t i = 0 ; i < sizeof( blinkbios_host_serialno ) ; i++ ) {
+        blinkbios_host_serialno[i] = next_entropy();
+    }
+
+    wake_hint = BLINKBIOS_HOST_NEVER;
+
+    blinkbios_button_block.wokeFlag = 0;                // Set to 0 on power up
+    blinkbios_pixel_block.start_state = BLINKBIOS_START_STATE_POWER_UP;
+
+    BLINKBIOS_POSTPONE_SLEEP_VECTOR();
+
+    getcontext( &tile_context );
+
+    tile_context.uc_stack.ss_sp = stack;
+    tile_context.uc_stack.ss_size = stack_size;
+    tile_context.uc_link = &bios_context;
+
+    makecontext( &tile_context , foreground_entry , 0 );
+
+}
+
+uint8_t blinkbios_host_step( void ) {
+
+    if ( stopped_reason ) {
+        return stopped_reason;
+    }
+
+    if ( cold_sleep_flag ) {
+        return BLINKBIOS_HOST_STEP_SLEEP;
+    }
+
+    // Forget the hint once we get there. If the foreground is still waiting on something it will tell us again.
+
+    if ( wake_hint <= blinkbios_millis_block.millis ) {
+        wake_hint = BLINKBIOS_HOST_NEVER;
+    }
+
+    wake_hinted_flag = 0;
+
+    swapcontext( &bios_context , &tile_context );
+
+    return step_reason;
+
+}
+
+void blinkbios_host_advance( uint32_t ms ) {
+
+    while ( ms ) {
+
+        if ( button_idle() && !( WDTCSR & _BV( WDIE ) ) ) {
+
+            if ( cold_sleep_flag ) {
+
+                // Asleep and nobody is pressing the button, so nothing will happen at all
+
+                return;
+
+            }
+
+            // All a tick would do is count millis, so skip right up to when we would go to sleep
+
+            uint32_t awake = 0;
+
+            if ( blinkbios_millis_block.millis < blinkbios_millis_block.sleep_time ) {
+                awake = blinkbios_millis_block.sleep_time - blinkbios_millis_block.millis;
+            }
+
+            if ( awake ) {
+
+                uint32_t chunk = ( ms < awake ) ? ms : awake;
+
+                blinkbios_millis_block.millis += chunk;
+                blinkbios_millis_block.step_8us = 0;
+                blinkbios_pixel_block.vertical_blanking_interval = 1;
+
+                ms -= chunk;
+
+                continue;
+
+            }
+
+        }
+
+        bios_tick();
+        ms--;
+
+    }
+
+}
+
+void blinkbios_host_set_button( uint8_t down ) {
+
+    physical_button_down = down;
+
+}
+
+uint8_t blinkbios_host_ir_receive( uint8_t face , const uint8_t *data , uint8_t len ) {
+
+    ir_rx_state_t *ir_rx_state = &blinkbios_irdata_block.ir_rx_states[ face ];
+
+    if ( ir_rx_state->packetBufferReady || len == 0 || len > IR_RX_PACKET_SIZE ) {
+        return 0;
+    }
+
+    ir_rx_state->packetBuffer[0] = IR_USER_DATA_HEADER_BYTE;
+    memcpy( (uint8_t *) ir_rx_state->packetBuffer + 1 , data , len );
+    ir_rx_state->packetBufferLen = len + 1;
+    ir_rx_state->packetBufferReady = 1;
+
+    return 1;
+
+}
+
+uint32_t blinkbios_host_next_wake( void ) {
+
+    if ( cold_sleep_flag ) {
+        return BLINKBIOS_HOST_NEVER;
+    }
+
+    if ( WDTCSR & _BV( WDIE ) ) {
+
+        // randomize() is waiting on the next WDT tick
+
+        return blinkbios_millis_block.millis + 1;
+
+    }
+
+    if ( step_reason == BLINKBIOS_HOST_STEP_FRAME && !wake_hinted_flag ) {
+
+        // blinklib gives hints every pass though loop(), so this frame must have come from somewhere else
+        // (like the warm sleep animation) that expects to keep going on the next frame
+
+        return blinkbios_millis_block.millis + 1;
+
+    }
+
+    // We will go to cold sleep on the tick that takes millis past sleep_time
+
+    uint32_t next = blinkbios_millis_block.sleep_time + 1;
+
+    if ( wake_hint < next ) {
+        next = wake_hint;
+    }
+
+    return next;
+
+}
+
+uint32_t blinkbios_host_millis( void ) {
+
+    return blinkbios_millis_block.millis;
+
+}
+
+uint16_t blinkbios_host_get_pixel( uint8_t face ) {
+
+    return blinkbios_pixel_block.pixelBuffer[ face ].as_uint16;
+
+}
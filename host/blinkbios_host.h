@@ -0,0 +1,105 @@
+/*
+ * blinkbios_host.h
+ *
+ * Interface between a tile image built for the host and the program that drives it.
+ *
+ * On a real tile the BlinkBIOS lives up in the bootloader and runs in the background out of ISRs. In a host build
+ * the BIOS is emulated in `blinkbios_host.cpp`, which gets linked right into the tile image along with blinklib and
+ * the sketch. The foreground (`run()` and everything it calls) runs as a coroutine, and it yields back to whoever is
+ * driving it every time it calls BLINKBIOS_DISPLAY_PIXEL_BUFFER_VECTOR() (which is once per pass though loop()) or
+ * spins waiting for the BIOS to do something.
+ *
+ * The driver only ever talks to the tile through the `extern "C"` functions below so that the tile image can also be
+ * built as a shared object and loaded many times over.
+ *
+ */
+
+#ifndef BLINKBIOS_HOST_H_
+#define BLINKBIOS_HOST_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Values returned by blinkbios_host_step() telling you why the foreground gave control back
+
+#define BLINKBIOS_HOST_STEP_FRAME       0   // Called BLINKBIOS_DISPLAY_PIXEL_BUFFER_VECTOR(), so one frame is done
+#define BLINKBIOS_HOST_STEP_SPIN        1   // Busy waiting for the BIOS (warm sleep, randomize(), etc)
+#define BLINKBIOS_HOST_STEP_SLEEP       2   // BIOS has put the tile into cold sleep. Only a button press will wake it.
+#define BLINKBIOS_HOST_STEP_SEED        3   // Tile jumped into the seed (game download) code and will not come back
+#define BLINKBIOS_HOST_STEP_ABEND       4   // Tile called BLINKBIOS_ABEND_VECTOR() and will not come back
+
+// How long the BIOS waits after the last button press (or BLINKBIOS_POSTPONE_SLEEP_VECTOR()) before it cold sleeps
+
+#define BLINKBIOS_HOST_SLEEP_TIMEOUT_MS     ( 2 * 60 * 60 * 1000UL )  // 2 hours
+
+// Returned by blinkbios_host_next_wake() when there is nothing to wait for
+
+#define BLINKBIOS_HOST_NEVER                0xffffffffUL
+
+// Callbacks from the emulated BIOS out to the driver
+
+struct blinkbios_host_env_t {
+
+    void *context;          // Passed back unchanged to all of the callbacks below
+
+    // Called from BLINKBIOS_IRDATA_SEND_PACKET_VECTOR. Return 1 if the packet was sent, 0 if it could not be.
+    // `data` does not include the BIOS packet type byte.
+
+    uint8_t (*ir_send)( void *context , uint8_t face , const uint8_t *data , uint8_t len );
+
+    // Called for each byte sent out the service port serial
+
+    void (*sp_tx)( void *context , uint8_t b );
+
+    // Used to make up the serial number and to seed the entropy that randomize() gathers
+
+    uint32_t seed;
+
+};
+
+extern "C" {
+
+    // Set up a freshly loaded tile image as if it was just powered up.
+    // The foreground will run on the supplied stack, which must stay valid as long as the tile does.
+
+    void blinkbios_host_boot( const blinkbios_host_env_t *env , void *stack , size_t stack_size );
+
+    // Run the foreground until it yields back to the BIOS. Returns one of the BLINKBIOS_HOST_STEP_* values.
+    // Does not run the foreground at all if the tile is asleep, seeding, or dead.
+
+    uint8_t blinkbios_host_step( void );
+
+    // Run the BIOS background for `ms` milliseconds. This is everything the BIOS would have done
+    // in its ISRs in that time (updating millis, button debounce and clicks, going to sleep).
+    // Stretches where the button is idle are done in one jump, so this is cheap even for hours at a time.
+
+    void blinkbios_host_advance( uint32_t ms );
+
+    // Set the physical state of the button (1=down). The BIOS will see it on the next tick.
+
+    void blinkbios_host_set_button( uint8_t down );
+
+    // Hand a packet to the BIOS receiver on the specified face as if it had just come in over IR.
+    // `data` does not include the BIOS packet type byte (the BIOS adds it).
+    // Returns 0 if the packet was dropped because the foreground has not yet consumed the last one on this face.
+
+    uint8_t blinkbios_host_ir_receive( uint8_t face , const uint8_t *data , uint8_t len );
+
+    // The earliest BIOS millis when something the tile is waiting for could happen (a Timer going off, an IR probe
+    // being due, a face expiring, going to cold sleep), based on the BLINKBIOS_WAKE_HINT()s the foreground has given us.
+    // Until then, the only things that can change what the tile does are the button and incoming IR packets, so a driver
+    // can skip right over the time in between. Returns BLINKBIOS_HOST_NEVER if only the button can wake the tile.
+
+    uint32_t blinkbios_host_next_wake( void );
+
+    // Current BIOS millisecond counter
+
+    uint32_t blinkbios_host_millis( void );
+
+    // The color that the foreground most recently displayed on the specified face, as the raw 16 bit pixelColor_t
+
+    uint16_t blinkbios_host_get_pixel( uint8_t face );
+
+}
+
+#endif /* BLINKBIOS_HOST_H_ */
@@ -0,0 +1,40 @@
+/*
+ * blinklib_host.h
+ *
+ * This file is force-included (with `-include`) at the top of every translation unit in a host tile image.
+ * It fills in the couple of places where blinklib needs a little help to run on top of the emulated BIOS
+ * rather than real hardware.
+ *
+ */
+
+#ifndef BLINKLIB_HOST_H_
+#define BLINKLIB_HOST_H_
+
+#include <stdint.h>
+
+// glibc has its own `ulong` that is an `unsigned long`, which collides with the `uint32_t` one in ArduinoTypes.h.
+// We pull in glibc's under a different name now so that it is already out of the way later.
+
+#define ulong glibc_ulong
+#include <sys/types.h>
+#undef ulong
+
+// Anywhere blinklib busy-waits for the BIOS, it must yield so the BIOS gets a chance to run
+
+extern "C" void blinkbios_host_spin( void );
+
+#define BLINKBIOS_SPIN_YIELD() blinkbios_host_spin()
+
+// Lets the driver fast forward over time when the tile is just waiting for a timer to go off
+
+extern "C" void blinkbios_host_wake_hint( uint32_t millis );
+
+#define BLINKBIOS_WAKE_HINT( t ) blinkbios_host_wake_hint( t )
+
+// There is no signature row to read the serial number out of, so we make one up for each tile
+
+extern uint8_t blinkbios_host_serialno[];
+
+#define BLINKLIB_SERIALNO_ADDR ( blinkbios_host_serialno )
+
+#endif /* BLINKLIB_HOST_H_ */
@@ -0,0 +1,945 @@
+/*
+ * cluster.cpp
+ *
+ * Simulates a whole cluster of tiles all running the same sketch, connected face to face in a hex grid.
+ *
+ * Each tile gets its own copy of everything a real tile has in RAM (blinklib's `faces[]` and `now`, the BIOS
+ * shared blocks, the sketch's variables) by swapping tile states in and out of a single loaded tile image
+ * (see tile_image.h). When a tile sends an IR packet on a face, it lands in the packet buffer of the same
+ * BIOS receiver on the neighboring tile's opposite face.
+ *
+ * The cluster is split into horizontal bands of tiles called regions, and each region runs on its own thread with its own
+ * copy of the tile image. All the regions run one quantum of cluster time (the link latency) in parallel and then wait for
+ * each other. Packets that cross into another region go though a lock-free single-producer/single-consumer queue for that
+ * pair of regions. Since a packet always takes at least one quantum to arrive, nobody ever needs a packet that is still
+ * being produced, and runs come out exactly the same no matter how many threads are used.
+ *
+ * Usage: cluster tile.so [-r radius | -g WxH] [-t ms] [-f frame_ms] [-l latency_ms] [-j threads] [-p tile:at_ms:duration_ms]... [-i ms] [-s seed] [-L loss_percent] [-B flip_percent] [-d pixels.csv] [-x] [-q]
+ *
+ *  -r  Make a hexagon shaped cluster with this many rings around the center tile (3r(r+1)+1 tiles)
+ *  -g  Make a W wide by H high cluster (rows offset like a honeycomb)
+ *  -t  How many milliseconds of cluster time to run (default 10000)
+ *  -f  How many milliseconds each pass though loop() takes (default 55)
+ *  -l  How many milliseconds an IR packet takes to get to the neighbor (default 1). Longer means fewer thread syncs.
+ *  -j  How many threads to use (default is one per core, but no fewer than 64 tiles per thread)
+ *  -p  Press the button on tile number `tile` at `at_ms` for `duration_ms`. Can be repeated.
+ *  -i  Print a line of stats every this many milliseconds of cluster time
+ *  -s  Base seed for tile serial numbers and randomize() entropy
+ *  -L  Lose this percent of IR packets on the way to the neighbor
+ *  -B  Flip one random bit in this percent of the IR packets that do get there
+ *  -d  Write the final color of every face of every tile to this CSV file
+ *  -x  Fast forward. Each tile only runs when something is due to happen (a Timer, an IR probe, a packet arriving,
+ *      the button, sleep) instead of every frame.
+ *  -q  Do not print service port output from the tiles
+ *
+ * Tile number 0 is the center of a hexagon cluster, or the top left of a grid.
+ *
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sched.h>
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <queue>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "tile_image.h"
+#include "spsc_queue.h"
+
+#define FACE_COUNT 6
+
+#define TILE_STACK_SIZE ( 64 * 1024 )
+
+#define MIN_TILES_PER_THREAD 64
+
+// Biggest packet that the BIOS will hand us. Matches IR_RX_PACKET_SIZE in blinkbios_shared_irdata.h.
+
+#define PACKET_MAX_LEN 40
+
+// Bits in the first byte of every blinklib packet (see irValueEncode() in blinklib.cpp)
+
+#define HEADER_POSTPONE_SLEEP_BIT   0b01000000
+
+// The axial hex grid (q,r) offset to get to the neighbor on each face.
+// Faces go clockwise, so face f is always opposite face (f+3)%6.
+
+static const int face_dq[ FACE_COUNT ] = { +1 ,  0 , -1 , -1 ,  0 , +1 };
+static const int face_dr[ FACE_COUNT ] = {  0 , +1 , +1 ,  0 , -1 , -1 };
+
+struct packet_t {
+    uint32_t arrival;       // Cluster time when this packet gets to the receiver
+    uint32_t tile;          // Destination tile
+    uint8_t face;           // Destination face
+    uint8_t len;
+    uint8_t data[ PACKET_MAX_LEN ];
+};
+
+struct button_event_t {
+    uint32_t at;
+    uint8_t down;
+};
+
+struct stats_t {
+    uint64_t frames;
+    uint64_t packets_sent;
+    uint64_t packets_delivered;
+    uint64_t packets_dropped;       // Receiver had not read the previous packet on that face yet
+    uint64_t packets_nowhere;       // No neighbor on that face
+    uint64_t packets_lost;          // Thrown away by -L
+    uint64_t packets_flipped;       // Had a bit flipped by -B
+    uint64_t postpone_packets;      // Packets carrying the viral postpone sleep bit
+
+    void add( const stats_t &other ) {
+        frames            += other.frames;
+        packets_sent      += other.packets_sent;
+        packets_delivered += other.packets_delivered;
+        packets_dropped   += other.packets_dropped;
+        packets_nowhere   += other.packets_nowhere;
+        packets_lost      += other.packets_lost;
+        packets_flipped   += other.packets_flipped;
+        postpone_packets  += other.postpone_packets;
+    }
+};
+
+typedef SpscQueue<packet_t> mailbox_t;
+
+typedef std::pair< uint32_t , uint32_t > wakeup_t;       // ( cluster time , tile )
+
+struct region_t;
+
+struct tile_t {
+
+    uint32_t index;
+    int q , r;
+
+    int32_t neighbor[ FACE_COUNT ];         // Index of the tile on each face or -1 if none
+
+    region_t *region;
+
+    uint8_t *state;                         // Saved contents of the tile image writable segment
+    void *stack;
+
+    uint32_t bios_time;                     // Cluster time that this tile's BIOS has been advanced to
+    uint8_t dead;                           // Will never run again (seed or abend)
+    uint8_t last_step;
+
+    uint32_t wake_at;                       // When this tile is next due to run. Older entries in the wakeup queue are stale.
+    uint32_t busy_until;                    // The step it last ran takes until this time, so it can not run again before then
+
+    std::vector<packet_t> inbox;            // Packets on their way to this tile
+
+    std::vector<button_event_t> button_events;
+    size_t next_button_event;
+
+    std::string sp_line;                    // Service port output not yet printed
+
+    uint32_t noise;                         // xorshift state for -L and -B. Only the sending tile uses it, so runs stay repeatable.
+
+};
+
+// A band of tiles that all run on the same thread
+
+struct region_t {
+
+    uint32_t index;
+
+    TileImage *image;                       // Our own private copy
+
+    // Earliest first, ties go to the lower tile number so runs are repeatable
+
+    std::priority_queue< wakeup_t , std::vector<wakeup_t> , std::greater<wakeup_t> > wakeups;
+
+    std::vector<packet_t> outbox;           // Packets sent during the current quantum
+
+    std::vector<mailbox_t *> mailbox_to;    // Indexed by destination region. NULL if we never send there.
+    std::vector<mailbox_t *> mailbox_from;  // The ones other regions send to us
+
+    stats_t stats;
+
+    uint32_t next_event;                    // Earliest tile wakeup or packet arrival we have coming after the current quantum
+
+};
+
+// A barrier for threads that expect to wait only very briefly.
+// The last thread to arrive runs `completion` before letting everyone go.
+
+class SpinBarrier {
+
+    public:
+
+        SpinBarrier( unsigned count , std::function<void()> completion ) : m_count( count ) , m_waiting( 0 ) , m_generation( 0 ) , m_completion( completion ) {}
+
+        void wait() {
+
+            unsigned generation = m_generation.load( std::memory_order_acquire );
+
+            if ( m_waiting.fetch_add( 1 , std::memory_order_acq_rel ) + 1 == m_count ) {
+
+                m_completion();
+                m_waiting.store( 0 , std::memory_order_relaxed );
+                m_generation.fetch_add( 1 , std::memory_order_release );
+
+            } else {
+
+                unsigned spins = 0;
+
+                while ( m_generation.load( std::memory_order_acquire ) == generation ) {
+
+                    // Give up the core if it is taking a while, in case there are more threads than cores
+
+                    if ( ++spins > 1000 ) {
+                        sched_yield();
+                    }
+
+                }
+
+            }
+
+        }
+
+    private:
+
+        const unsigned m_count;
+        std::atomic<unsigned> m_waiting;
+        std::atomic<unsigned> m_generation;
+        std::function<void()> m_completion;
+
+};
+
+static std::vector<tile_t> tiles;
+
+static std::vector<region_t> regions;
+
+static uint32_t run_ms = 10000;
+static uint32_t frame_ms = 55;
+static uint32_t latency_ms = 1;
+static uint32_t interval_ms = 0;
+
+static uint32_t loss_percent = 0;
+static uint32_t flip_percent = 0;
+
+static uint8_t quiet_flag;
+static uint8_t fast_forward_flag;
+
+// Next number from the tile's own noise generator (Marsaglia xorshift32)
+
+static uint32_t tile_noise( tile_t *tile ) {
+
+    uint32_t x = tile->noise;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+
+    tile->noise = x;
+
+    return x;
+}
+
+// --- Callbacks from the tiles
+
+static uint8_t cluster_ir_send( void *context , uint8_t face , const uint8_t *data , uint8_t len ) {
+
+    tile_t *tile = (tile_t *) context;
+    region_t *region = tile->region;
+
+    region->stats.packets_sent++;
+
+    if ( data[0] & HEADER_POSTPONE_SLEEP_BIT ) {
+        region->stats.postpone_packets++;
+    }
+
+    int32_t neighbor = tile->neighbor[ face ];
+
+    if ( neighbor < 0 || len > PACKET_MAX_LEN ) {
+        region->stats.packets_nowhere++;
+        return 1;
+    }
+
+    // As far as the sender can tell, a lost packet went out just fine
+
+    if ( loss_percent && tile_noise( tile ) % 100 < loss_percent ) {
+        region->stats.packets_lost++;
+        return 1;
+    }
+
+    packet_t packet;
+
+    packet.arrival = tile->bios_time + latency_ms;
+    packet.tile = neighbor;
+    packet.face = ( face + FACE_COUNT / 2 ) % FACE_COUNT;
+    packet.len = len;
+    memcpy( packet.data , data , len );
+
+    if ( flip_percent && len && tile_noise( tile ) % 100 < flip_percent ) {
+
+        uint32_t bit = tile_noise( tile ) % ( len * 8U );
+
+        packet.data[ bit / 8 ] ^= 1 << ( bit % 8 );
+        region->stats.packets_flipped++;
+
+    }
+
+    region->outbox.push_back( packet );
+
+    return 1;
+}
+
+static void cluster_sp_tx( void *context , uint8_t b ) {
+
+    tile_t *tile = (tile_t *) context;
+
+    if ( b == '\n' ) {
+
+        if ( !quiet_flag ) {
+            printf( "tile %u: %s\n" , tile->index , tile->sp_line.c_str() );
+        }
+
+        tile->sp_line.clear();
+
+    } else if ( b != '\r' ) {
+
+        tile->sp_line += (char) b;
+
+    }
+
+}
+
+// --- Layout
+
+static void add_tile( std::map< std::pair<int,int> , uint32_t > &grid , int q , int r ) {
+
+    tile_t tile = tile_t();
+
+    tile.index = tiles.size();
+    tile.q = q;
+    tile.r = r;
+
+    grid[ std::make_pair( q , r ) ] = tile.index;
+
+    tiles.push_back( tile );
+
+}
+
+static void connect_neighbors( std::map< std::pair<int,int> , uint32_t > &grid ) {
+
+    for( tile_t &tile : tiles ) {
+
+        for( int f = 0 ; f < FACE_COUNT ; f++ ) {
+
+            auto it = grid.find( std::make_pair( tile.q + face_dq[f] , tile.r + face_dr[f] ) );
+
+            tile.neighbor[f] = ( it == grid.end() ) ? -1 : (int32_t) it->second;
+        }
+    }
+
+}
+
+static void make_hexagon( int radius ) {
+
+    std::map< std::pair<int,int> , uint32_t > grid;
+
+    add_tile( grid , 0 , 0 );       // Center first so it is tile 0
+
+    for( int r = -radius ; r <= radius ; r++ ) {
+        for( int q = -radius ; q <= radius ; q++ ) {
+
+            if ( ( q || r ) && abs( q + r ) <= radius ) {
+                add_tile( grid , q , r );
+            }
+
+        }
+    }
+
+    connect_neighbors( grid );
+
+}
+
+static void make_grid( int width , int height ) {
+
+    std::map< std::pair<int,int> , uint32_t > grid;
+
+    for( int row = 0 ; row < height ; row++ ) {
+        for( int col = 0 ; col < width ; col++ ) {
+
+            add_tile( grid , col - row / 2 , row );     // Offset rows to axial coordinates
+
+        }
+    }
+
+    connect_neighbors( grid );
+
+}
+
+// Cut the cluster into `count` bands of rows with about the same number of tiles in each.
+// Bands only touch the bands right above and below them, so each region has at most two mailboxes in and out.
+
+static void make_regions( unsigned count , const char *image_path ) {
+
+    std::vector<uint32_t> order( tiles.size() );
+
+    for( uint32_t i = 0 ; i < order.size() ; i++ ) {
+        order[i] = i;
+    }
+
+    std::stable_sort( order.begin() , order.end() , []( uint32_t a , uint32_t b ) {
+        return tiles[a].r != tiles[b].r ? tiles[a].r < tiles[b].r : tiles[a].q < tiles[b].q;
+    } );
+
+    regions.resize( count );
+
+    for( unsigned i = 0 ; i < count ; i++ ) {
+
+        regions[i].index = i;
+        regions[i].image = new TileImage( image_path );
+        regions[i].mailbox_to.assign( count , nullptr );
+
+    }
+
+    for( size_t i = 0 ; i < order.size() ; i++ ) {
+        tiles[ order[i] ].region = &regions[ i * count / order.size() ];
+    }
+
+    for( const tile_t &tile : tiles ) {
+
+        for( int f = 0 ; f < FACE_COUNT ; f++ ) {
+
+            if ( tile.neighbor[f] < 0 ) continue;
+
+            region_t *from = tile.region;
+            region_t *to = tiles[ tile.neighbor[f] ].region;
+
+            if ( from != to && !from->mailbox_to[ to->index ] ) {
+
+                mailbox_t *mailbox = new mailbox_t();
+
+                from->mailbox_to[ to->index ] = mailbox;
+                to->mailbox_from.push_back( mailbox );
+
+            }
+
+        }
+
+    }
+
+}
+
+// --- Running
+
+static double host_seconds() {
+
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC , &ts );
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+
+}
+
+// Run the BIOS on the currently swapped in tile forward to cluster time `target`,
+// pressing and releasing the button on the way as scheduled
+
+static void catch_up( const TileImage &image , tile_t &tile , uint32_t target ) {
+
+    while ( tile.bios_time < target ) {
+
+        while ( tile.next_button_event < tile.button_events.size() && tile.button_events[ tile.next_button_event ].at <= tile.bios_time ) {
+            image.set_button( tile.button_events[ tile.next_button_event ].down );
+            tile.next_button_event++;
+        }
+
+        uint32_t chunk = target - tile.bios_time;
+
+        if ( tile.next_button_event < tile.button_events.size() ) {
+            chunk = std::min( chunk , tile.button_events[ tile.next_button_event ].at - tile.bios_time );
+        }
+
+        image.advance( chunk );
+        tile.bios_time += chunk;
+
+    }
+
+}
+
+// Run one tile for one step at cluster time `now`. Returns how long until it should run again.
+
+static uint32_t run_tile( region_t &region , tile_t &tile , uint32_t now ) {
+
+    const TileImage &image = *region.image;
+
+    image.swap_in( tile.state );
+
+    catch_up( image , tile , now );
+
+    // Hand over the packets that have arrived by now. Only one neighbor sends to each face, so the
+    // packets for any one face are always in the order they were sent.
+
+    size_t waiting = 0;
+
+    for( const packet_t &packet : tile.inbox ) {
+
+        if ( packet.arrival > now ) {
+
+            tile.inbox[ waiting++ ] = packet;
+
+        } else if ( image.ir_receive( packet.face , packet.data , packet.len ) ) {
+
+            region.stats.packets_delivered++;
+
+        } else {
+
+            region.stats.packets_dropped++;
+
+        }
+
+    }
+
+    tile.inbox.resize( waiting );
+
+    uint8_t step = image.step();
+
+    tile.last_step = step;
+
+    uint32_t delay;
+
+    switch ( step ) {
+
+        case BLINKBIOS_HOST_STEP_FRAME:
+            region.stats.frames++;
+            delay = frame_ms;
+            break;
+
+        case BLINKBIOS_HOST_STEP_SPIN:
+            delay = 1;
+            break;
+
+        case BLINKBIOS_HOST_STEP_SLEEP:
+            delay = frame_ms;           // Check back later to see if someone pressed the button
+            break;
+
+        default:
+            tile.dead = 1;
+            delay = 0;
+            break;
+
+    }
+
+    tile.busy_until = now + delay;
+
+    if ( fast_forward_flag && !tile.dead ) {
+
+        // Nothing can change until the tile's next wake, the next button event, or the next packet arrives.
+        // Packets that get sent to us later will move our wakeup up (see deliver()).
+
+        uint32_t skip = run_ms - now;
+
+        uint32_t next_wake = image.next_wake();
+
+        if ( next_wake != BLINKBIOS_HOST_NEVER ) {
+            skip = std::min( skip , next_wake - image.millis() );
+        }
+
+        if ( tile.next_button_event < tile.button_events.size() ) {
+            skip = std::min( skip , tile.button_events[ tile.next_button_event ].at - now );
+        }
+
+        for( const packet_t &packet : tile.inbox ) {
+            skip = std::min( skip , packet.arrival - now );
+        }
+
+        delay = std::max( delay , skip );
+
+    }
+
+    image.swap_out( tile.state );
+
+    return delay;
+
+}
+
+// Put a packet in a tile's inbox. Only ever called from the thread that runs the tile.
+
+static void deliver( tile_t &tile , const packet_t &packet ) {
+
+    tile.inbox.push_back( packet );
+
+    if ( fast_forward_flag && !tile.dead ) {
+
+        // Wake the tile up to get it (but not before it is done with what it is doing now)
+
+        uint32_t at = std::max( packet.arrival , tile.busy_until );
+
+        if ( at < tile.wake_at ) {
+            tile.wake_at = at;
+            tile.region->wakeups.push( wakeup_t( at , tile.index ) );
+        }
+
+    }
+
+}
+
+// Run all the tiles in a region from `start` up to (but not including) `end`
+
+static void run_quantum( region_t &region , uint32_t start , uint32_t end ) {
+
+    // First collect packets that other regions sent during the last quantum.
+    // Anything they are sending right now will not arrive until after `end`, so we leave it for next time.
+
+    for( mailbox_t *mailbox : region.mailbox_from ) {
+
+        const packet_t *packet;
+
+        while ( ( packet = mailbox->front() ) && packet->arrival < end ) {
+
+            deliver( tiles[ packet->tile ] , *packet );
+            mailbox->pop();
+
+        }
+
+    }
+
+    while ( !region.wakeups.empty() && region.wakeups.top().first < end ) {
+
+        wakeup_t wakeup = region.wakeups.top();
+
+        region.wakeups.pop();
+
+        tile_t &tile = tiles[ wakeup.second ];
+
+        if ( wakeup.first != tile.wake_at ) {
+            continue;               // Got moved up by a packet and already ran
+        }
+
+        uint32_t now = std::max( wakeup.first , start );
+
+        uint32_t delay = run_tile( region , tile , now );
+
+        if ( !tile.dead ) {
+            tile.wake_at = now + delay;
+            region.wakeups.push( wakeup_t( tile.wake_at , tile.index ) );
+        }
+
+    }
+
+    region.next_event = region.wakeups.empty() ? BLINKBIOS_HOST_NEVER : region.wakeups.top().first;
+
+    // Send off what we sent
+
+    for( const packet_t &packet : region.outbox ) {
+
+        region_t *to = tiles[ packet.tile ].region;
+
+        if ( to == &region ) {
+            deliver( tiles[ packet.tile ] , packet );
+        } else {
+            region.mailbox_to[ to->index ]->push( packet );
+        }
+
+        region.next_event = std::min( region.next_event , packet.arrival );
+
+    }
+
+    region.outbox.clear();
+
+}
+
+static void print_stats( uint32_t now , double host_elapsed ) {
+
+    stats_t total = stats_t();
+
+    for( const region_t &region : regions ) {
+        total.add( region.stats );
+    }
+
+    printf( "%10u ms  %12lu frames  %12lu sent  %12lu delivered  %10lu dropped  %10lu postpone  %8.3f s\n" ,
+            now ,
+            (unsigned long) total.frames ,
+            (unsigned long) total.packets_sent ,
+            (unsigned long) total.packets_delivered ,
+            (unsigned long) total.packets_dropped ,
+            (unsigned long) total.postpone_packets ,
+            host_elapsed );
+
+}
+
+static void write_pixels( const char *filename ) {
+
+    FILE *f = fopen( filename , "w" );
+
+    if (!f) {
+        fprintf( stderr , "Could not open %s\n" , filename );
+        return;
+    }
+
+    fprintf( f , "tile,q,r,face,red,green,blue\n" );
+
+    for( const tile_t &tile : tiles ) {
+
+        const TileImage &image = *tile.region->image;
+
+        image.swap_in( tile.state );
+
+        for( uint8_t face = 0 ; face < FACE_COUNT ; face++ ) {
+
+            uint16_t c = image.get_pixel( face );
+
+            // Unpack the 5 bit r,g,b fields of pixelColor_t
+
+            fprintf( f , "%u,%d,%d,%u,%u,%u,%u\n" , tile.index , tile.q , tile.r , face , ( c >> 1 ) & 0x1f , ( c >> 6 ) & 0x1f , ( c >> 11 ) & 0x1f );
+        }
+
+    }
+
+    fclose( f );
+
+}
+
+static void usage( const char *name ) {
+
+    fprintf( stderr , "Usage: %s tile.so [-r radius | -g WxH] [-t ms] [-f frame_ms] [-l latency_ms] [-j threads] [-p tile:at_ms:duration_ms]... [-i ms] [-s seed] [-L loss_percent] [-B flip_percent] [-d pixels.csv] [-x] [-q]\n" , name );
+    exit( 1 );
+
+}
+
+int main( int argc , char **argv ) {
+
+    int radius = 2;
+    int width = 0 , height = 0;
+    unsigned thread_count = 0;
+    uint32_t seed = 1;
+    const char *pixels_file = NULL;
+
+    std::vector< std::pair< uint32_t , button_event_t > > presses;
+
+    int opt;
+
+    while ( (opt = getopt( argc , argv , "r:g:t:f:l:j:p:i:s:L:B:d:xq" )) != -1 ) {
+
+        switch (opt) {
+
+            case 'r':
+                radius = atoi( optarg );
+                break;
+
+            case 'g':
+                if ( sscanf( optarg , "%dx%d" , &width , &height ) != 2 || width < 1 || height < 1 ) usage( argv[0] );
+                break;
+
+            case 't':
+                run_ms = strtoul( optarg , NULL , 0 );
+                break;
+
+            case 'f':
+                frame_ms = strtoul( optarg , NULL , 0 );
+                break;
+
+            case 'l':
+                latency_ms = strtoul( optarg , NULL , 0 );
+                break;
+
+            case 'j':
+                thread_count = strtoul( optarg , NULL , 0 );
+                break;
+
+            case 'p': {
+                unsigned tile , at , duration;
+                if ( sscanf( optarg , "%u:%u:%u" , &tile , &at , &duration ) != 3 ) usage( argv[0] );
+                presses.push_back( { tile , { at , 1 } } );
+                presses.push_back( { tile , { at + duration , 0 } } );
+                break;
+            }
+
+            case 'i':
+                interval_ms = strtoul( optarg , NULL , 0 );
+                break;
+
+            case 's':
+                seed = strtoul( optarg , NULL , 0 );
+                break;
+
+            case 'L':
+                loss_percent = strtoul( optarg , NULL , 0 );
+                break;
+
+            case 'B':
+                flip_percent = strtoul( optarg , NULL , 0 );
+                break;
+
+            case 'd':
+                pixels_file = optarg;
+                break;
+
+            case 'x':
+                fast_forward_flag = 1;
+                break;
+
+            case 'q':
+                quiet_flag = 1;
+                break;
+
+            default:
+                usage( argv[0] );
+        }
+
+    }
+
+    if ( optind != argc - 1 ) usage( argv[0] );
+
+    if ( frame_ms == 0 ) frame_ms = 1;
+    if ( latency_ms == 0 ) latency_ms = 1;
+
+    if ( width ) {
+        make_grid( width , height );
+    } else {
+        make_hexagon( radius );
+    }
+
+    if ( thread_count == 0 ) {
+
+        thread_count = std::max( 1U , std::thread::hardware_concurrency() );
+        thread_count = std::min( thread_count , (unsigned) std::max( (size_t) 1 , tiles.size() / MIN_TILES_PER_THREAD ) );
+
+    }
+
+    thread_count = std::min( thread_count , (unsigned) tiles.size() );
+
+    make_regions( thread_count , argv[ optind ] );
+
+    for( const auto &press : presses ) {
+
+        if ( press.first < tiles.size() ) {
+            tiles[ press.first ].button_events.push_back( press.second );
+        }
+
+    }
+
+    // One big block for all the stacks. Only the pages that actually get touched use any memory.
+
+    uint8_t *stacks = (uint8_t *) mmap( NULL , tiles.size() * (size_t) TILE_STACK_SIZE , PROT_READ | PROT_WRITE , MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE , -1 , 0 );
+
+    if ( stacks == MAP_FAILED ) {
+        fprintf( stderr , "Could not allocate stacks for %zu tiles\n" , tiles.size() );
+        return 1;
+    }
+
+    for( tile_t &tile : tiles ) {
+
+        std::stable_sort( tile.button_events.begin() , tile.button_events.end() , []( const button_event_t &a , const button_event_t &b ) { return a.at < b.at; } );
+
+        const TileImage &image = *tile.region->image;
+
+        tile.state = (uint8_t *) malloc( image.state_size() );
+        tile.stack = stacks + tile.index * (size_t) TILE_STACK_SIZE;
+
+        blinkbios_host_env_t env = { &tile , cluster_ir_send , cluster_sp_tx , seed + tile.index * 2654435761U };
+
+        // Anything but 0 works as a xorshift seed
+
+        tile.noise = ( seed + tile.index * 2654435761U ) ^ 0x9e3779b9U;
+        if ( !tile.noise ) tile.noise = 1;
+
+        image.swap_in( image.pristine() );
+        image.boot( &env , tile.stack , TILE_STACK_SIZE );
+        image.swap_out( tile.state );
+
+        // Spread the tiles out over the first frame so they are not all in lock step
+
+        tile.wake_at = ( tile.index * 7919U ) % frame_ms;
+        tile.region->wakeups.push( wakeup_t( tile.wake_at , tile.index ) );
+
+    }
+
+    fprintf( stderr , "Running %zu tiles on %u threads, %zu bytes of state each\n" , tiles.size() , thread_count , regions[0].image->state_size() );
+
+    double start = host_seconds();
+
+    uint32_t quantum_start = 0;
+    uint32_t next_report = interval_ms;
+
+    SpinBarrier barrier( thread_count , [&]() {
+
+        // Everyone is done with the quantum, so safe to look at all the stats
+
+        // Skip right over any stretch where nobody has anything to do. Quanta do not need to line up with anything,
+        // they just need to be no longer than the latency.
+
+        uint32_t next_event = BLINKBIOS_HOST_NEVER;
+
+        for( const region_t &region : regions ) {
+            next_event = std::min( next_event , region.next_event );
+        }
+
+        quantum_start = std::max( quantum_start + latency_ms , std::min( next_event , run_ms ) );
+
+        while ( interval_ms && next_report <= quantum_start && next_report < run_ms ) {
+            print_stats( next_report , host_seconds() - start );
+            next_report += interval_ms;
+        }
+
+    } );
+
+    auto worker = [&]( region_t &region ) {
+
+        // Everyone sees the same quantum_start because it only changes inside the barrier
+
+        while ( quantum_start < run_ms ) {
+
+            run_quantum( region , quantum_start , std::min( quantum_start + latency_ms , run_ms ) );
+
+            barrier.wait();
+
+        }
+
+    };
+
+    std::vector<std::thread> threads;
+
+    for( unsigned i = 1 ; i < thread_count ; i++ ) {
+        threads.push_back( std::thread( worker , std::ref( regions[i] ) ) );
+    }
+
+    worker( regions[0] );
+
+    for( std::thread &thread : threads ) {
+        thread.join();
+    }
+
+    double host_elapsed = host_seconds() - start;
+
+    print_stats( run_ms , host_elapsed );
+
+    stats_t total = stats_t();
+
+    for( const region_t &region : regions ) {
+        total.add( region.stats );
+    }
+
+    unsigned seeding = 0 , abended = 0 , sleeping = 0;
+
+    for( const tile_t &tile : tiles ) {
+        if ( tile.last_step == BLINKBIOS_HOST_STEP_SEED  ) seeding++;
+        if ( tile.last_step == BLINKBIOS_HOST_STEP_ABEND ) abended++;
+        if ( tile.last_step == BLINKBIOS_HOST_STEP_SLEEP ) sleeping++;
+    }
+
+    fprintf( stderr , "%zu tiles, %lu tile frames in %.3f s host time (%.0f tile frames/s). %lu packets to nowhere, %lu lost, %lu flipped. %u seeding, %u abended, %u asleep.\n" ,
+             tiles.size() , (unsigned long) total.frames , host_elapsed , host_elapsed > 0 ? total.frames / host_elapsed : 0.0 ,
+             (unsigned long) total.packets_nowhere , (unsigned long) total.packets_lost , (unsigned long) total.packets_flipped , seeding , abended , sleeping );
+
+    if ( pixels_file ) {
+        write_pixels( pixels_file );
+    }
+
+    return 0;
+}
@@ -0,0 +1,78 @@
+#!/bin/sh
+#
+# Turn an Arduino sketch into a plain C++ file the way the Arduino IDE does before it compiles.
+#
+# This means adding `#include "Arduino.h"` at the top and a prototype for every function right
+# before the first function definition, so that sketches can call functions before they are defined.
+#
+# Usage: ino2cpp.sh Sketch.ino > Sketch.cpp
+#
+# This only understands the single-line function headers starting in column 0 that our sketches use.
+#
+
+ino="$1"
+
+awk -v ino="$ino" '
+
+    function is_function_head( line ,    code ) {
+
+        code = line
+        sub( /\/\/.*$/ , "" , code )
+
+        if ( code ~ /^(if|else|for|while|do|switch|return|typedef|struct|class|enum|union|case|default|#)/ ) return 0
+        if ( code ~ /;[ \t]*$/ ) return 0
+        if ( code ~ /=/ ) return 0
+
+        return code ~ /^[A-Za-z_][A-Za-z0-9_:<>]*([ \t*&]+[A-Za-z_][A-Za-z0-9_:<>]*)*[ \t*&]+[A-Za-z_][A-Za-z0-9_]*[ \t]*\([^;]*\)[ \t]*(\{.*)?$/
+    }
+
+    function prototype( line ,    p ) {
+        p = line
+        sub( /\/\/.*$/ , "" , p )
+        sub( /\{.*$/ , "" , p )
+        sub( /[ \t]+$/ , "" , p )
+        return p ";"
+    }
+
+    # First pass collects prototypes and where the first function starts
+
+    FNR == NR {
+
+        line = $0
+
+        if ( in_comment ) {
+            if ( line ~ /\*\// ) in_comment = 0
+            next
+        }
+
+        if ( line ~ /^[ \t]*\/\*/ && line !~ /\*\// ) {
+            in_comment = 1
+            next
+        }
+
+        if ( is_function_head( line ) ) {
+
+            if ( !first ) first = FNR
+
+            protos[ ++count ] = prototype( line )
+
+        }
+
+        next
+    }
+
+    # Second pass writes it all out
+
+    FNR == 1 {
+        print "#include \"Arduino.h\""
+        printf "#line 1 \"%s\"\n" , ino
+    }
+
+    FNR == first {
+        for( i = 1 ; i <= count ; i++ ) print protos[i]
+        printf "#line %d \"%s\"\n" , FNR , ino
+    }
+
+    { print }
+
+' "$ino" "$ino"
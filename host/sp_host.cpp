@@ -0,0 +1,43 @@
+/*
+ * Host version of the service port
+ *
+ * Anything sent out the service port serial is handed to the driver one byte at a time.
+ * Nothing ever comes in.
+ *
+ */
+
+#include "sp.h"
+
+#include "blinkbios_host.h"
+
+// Defined in blinkbios_host.cpp
+
+extern "C" void blinkbios_host_sp_tx( uint8_t b );
+
+void sp_serial_init(void) {
+}
+
+void sp_serial_tx(unsigned char b) {
+
+    blinkbios_host_sp_tx( b );
+
+}
+
+void sp_serial_flush(void) {
+}
+
+unsigned char sp_serial_rx_ready(void) {
+
+    return 0;
+
+}
+
+unsigned char sp_serial_rx(void) {
+
+    // Nothing will ever come, so this is as blocked as it gets
+
+    while (1) {
+        blinkbios_host_spin();
+    }
+
+}
@@ -0,0 +1,113 @@
+/*
+ * spsc_queue.h
+ *
+ * A lock-free unbounded queue for exactly one producer thread and one consumer thread.
+ *
+ * Items are stored in fixed size chunks. The producer only ever writes to the last chunk and the consumer only ever
+ * reads from (and eventually frees) the first chunk, so the only thing they share is the count of items in a chunk
+ * and the link to the next chunk. Unbounded so that the producer can never get stuck waiting on a consumer who is
+ * waiting on it.
+ *
+ */
+
+#ifndef SPSC_QUEUE_H_
+#define SPSC_QUEUE_H_
+
+#include <stddef.h>
+
+#include <atomic>
+
+template <typename T , size_t CHUNK_LEN = 256> class SpscQueue {
+
+    private:
+
+        struct chunk_t {
+            T items[ CHUNK_LEN ];
+            std::atomic<size_t> count;          // How many items the producer has finished writing into this chunk
+            std::atomic<chunk_t *> next;
+
+            chunk_t() : count( 0 ) , next( nullptr ) {}
+        };
+
+        chunk_t *m_head;                        // Consumer only
+        size_t m_head_pos;
+
+        chunk_t *m_tail;                        // Producer only
+
+    public:
+
+        SpscQueue() {
+            m_head = m_tail = new chunk_t();
+            m_head_pos = 0;
+        }
+
+        ~SpscQueue() {
+            while ( m_head ) {
+                chunk_t *next = m_head->next.load( std::memory_order_relaxed );
+                delete m_head;
+                m_head = next;
+            }
+        }
+
+        SpscQueue( const SpscQueue & ) = delete;
+        SpscQueue &operator=( const SpscQueue & ) = delete;
+
+        // Producer side
+
+        void push( const T &item ) {
+
+            size_t count = m_tail->count.load( std::memory_order_relaxed );
+
+            if ( count == CHUNK_LEN ) {
+
+                chunk_t *chunk = new chunk_t();
+                m_tail->next.store( chunk , std::memory_order_release );
+                m_tail = chunk;
+                count = 0;
+
+            }
+
+            m_tail->items[ count ] = item;
+            m_tail->count.store( count + 1 , std::memory_order_release );
+
+        }
+
+        // Consumer side. Returns the oldest item without removing it, or NULL if there are none.
+
+        const T *front() {
+
+            while (1) {
+
+                if ( m_head_pos < m_head->count.load( std::memory_order_acquire ) ) {
+                    return &m_head->items[ m_head_pos ];
+                }
+
+                if ( m_head_pos < CHUNK_LEN ) {
+                    return nullptr;
+                }
+
+                // Used up this chunk. Move on if the producer has started another.
+
+                chunk_t *next = m_head->next.load( std::memory_order_acquire );
+
+                if ( !next ) {
+                    return nullptr;
+                }
+
+                delete m_head;
+                m_head = next;
+                m_head_pos = 0;
+
+            }
+
+        }
+
+        // Consumer side. Only call after front() returned an item.
+
+        void pop() {
+            m_head_pos++;
+        }
+
+};
+
+#endif /* SPSC_QUEUE_H_ */
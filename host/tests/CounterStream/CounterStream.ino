@@ -0,0 +1,114 @@
+/*
+    CounterStream
+
+    Every tile streams a 16 bit counter out of every face that has a neighbor, as fast as blinklib will take it, and
+    checks that what comes in on each face counts up by one with nothing missing, repeated, or garbled.
+
+    Build with BLINKLIB_RELIABLE_DATAGRAMS and run it in a cluster with some loss (-L) and bit flips (-B). At REPORT_MS
+    every tile prints "ok" and how many datagrams it checked, or "FAIL" and what went wrong. `make test` does all that.
+*/
+
+#include "Serial.h"
+
+#define REPORT_MS 9000
+
+ServicePortSerial sp;
+
+word nextSend[ FACE_COUNT ];
+word nextExpected[ FACE_COUNT ];
+
+word received;
+word failures;
+
+bool reported;
+
+void setup() {
+
+  sp.begin();
+
+}
+
+// Each datagram is the counter low byte first, then a check byte of our own so that we notice if anything gets past
+// the blinklib checksum.
+
+void sendNext( byte f ) {
+
+  byte d[3];
+
+  d[0] = nextSend[f] & 0xff;
+  d[1] = nextSend[f] >> 8;
+  d[2] = d[0] ^ d[1] ^ 0x5a;
+
+  sendDatagramOnFace( d , 3 , f );
+  nextSend[f]++;
+
+}
+
+void checkNext( byte f ) {
+
+  const byte *d = getDatagramOnFace( f );
+
+  if ( getDatagramLengthOnFace( f ) != 3 || ( d[0] ^ d[1] ^ 0x5a ) != d[2] ) {
+
+    sp.print( "FAIL garbled on face " );
+    sp.println( f );
+    failures++;
+
+  } else {
+
+    word v = d[0] | ( d[1] << 8 );
+
+    if ( v != nextExpected[f] ) {
+      sp.print( "FAIL face " );
+      sp.print( f );
+      sp.print( " expected " );
+      sp.print( nextExpected[f] );
+      sp.print( " got " );
+      sp.println( v );
+      failures++;
+    }
+
+    nextExpected[f] = v + 1;
+    received++;
+
+  }
+
+  markDatagramReadOnFace( f );
+
+}
+
+void loop() {
+
+  FOREACH_FACE( f ) {
+
+    if ( isDatagramReadyOnFace( f ) ) {
+      checkNext( f );
+    }
+
+    // Wait until we know someone is there so the first one does not go out into the dark
+
+    if ( !isValueReceivedOnFaceExpired( f ) ) {
+      while ( getDatagramSlotsFreeOnFace( f ) ) {
+        sendNext( f );
+      }
+    }
+
+  }
+
+  if ( !reported && millis() >= REPORT_MS ) {
+
+    reported = true;
+
+    if ( failures || !received ) {
+      sp.print( "FAIL " );
+      sp.print( failures );
+      sp.print( " bad of " );
+      sp.println( received );
+    } else {
+      sp.print( "ok " );
+      sp.println( received );
+    }
+
+  }
+
+}
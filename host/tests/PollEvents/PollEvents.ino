@@ -0,0 +1,87 @@
+/*
+    PollEvents
+
+    Every tile changes the value it sends every frame and calls pollIR() at the end of loop(), after it has already
+    looked at its events (and sometimes after waiting around long enough for its neighbors to have sent something new). Anything pollIR() takes in must still show up as an event in the next loop(), so a tile
+    should never find a new value on a face without didValueOnFaceChange() saying so.
+
+    At REPORT_MS every tile prints "ok" and how many changes it saw, or "FAIL" and what went wrong. `make test` runs it.
+*/
+
+#include "Serial.h"
+
+#define REPORT_MS 9000
+
+ServicePortSerial sp;
+
+byte lastSeen[ FACE_COUNT ];
+
+byte sending;
+
+word changes;
+word failures;
+
+bool reported;
+
+void setup() {
+
+  sp.begin();
+
+}
+
+void loop() {
+
+  FOREACH_FACE( f ) {
+
+    byte v = getLastValueReceivedOnFace( f );
+
+    if ( didValueOnFaceChange( f ) ) {
+
+      changes++;
+
+    } else if ( v != lastSeen[f] ) {
+
+      sp.print( "FAIL missed change on face " );
+      sp.print( f );
+      sp.print( " from " );
+      sp.print( lastSeen[f] );
+      sp.print( " to " );
+      sp.println( v );
+      failures++;
+
+    }
+
+    lastSeen[f] = v;
+
+  }
+
+  sending = ( sending + 1 ) % ( IR_DATA_VALUE_MAX + 1 );
+  setValueSentOnAllFaces( sending );
+
+  if ( !reported && millis() >= REPORT_MS ) {
+
+    reported = true;
+
+    if ( failures || !changes ) {
+      sp.print( "FAIL " );
+      sp.print( failures );
+      sp.print( " missed, " );
+      sp.print( changes );
+      sp.println( " seen" );
+    } else {
+      sp.print( "ok " );
+      sp.println( changes );
+    }
+
+  }
+
+  // The whole point is that this comes after we looked. Every other frame, spend a while in randomize() first (it
+  // waits about half a second on the BIOS) so that there is sure to be something new for pollIR() to take in.
+
+  if ( sending & 1 ) {
+    randomize();
+  }
+
+  pollIR();
+
+}
@@ -0,0 +1,139 @@
+/*
+    Relay
+
+    For a single row of tiles (`cluster -g Nx1`). The tile on the west end (nobody on face 3) sends a 16 bit counter
+    east out of face 0 as fast as blinklib will take it. Every other tile checks that what comes in on face 3 counts up
+    by one with nothing missing, repeated, or garbled, and passes it on out of face 0 unless it is the east end. A tile
+    only marks a datagram read once it has been passed on, so a slow tile holds up everyone before it rather than losing
+    anything.
+
+    Build with BLINKLIB_RELIABLE_DATAGRAMS and run it with some loss (-L) and bit flips (-B). At REPORT_MS every tile
+    prints "ok" and how many datagrams it sent or checked, or "FAIL" and what went wrong. `make test` does all that.
+*/
+
+#include "Serial.h"
+
+#define REPORT_MS 9000
+
+// Give everyone time to find their neighbors before we decide who is on which end. We only decide once, since a face
+// can go expired for a moment when a few packets in a row get lost.
+
+#define START_MS  500
+
+ServicePortSerial sp;
+
+bool started;
+bool westEnd;
+bool eastEnd;
+
+word nextSend;
+word nextExpected;
+
+word count;
+word failures;
+
+bool reported;
+
+void setup() {
+
+  sp.begin();
+
+}
+
+// Each datagram is the counter low byte first, then a check byte of our own so that we notice if anything gets past
+// the blinklib checksum.
+
+void sendCount( word v ) {
+
+  byte d[3];
+
+  d[0] = v & 0xff;
+  d[1] = v >> 8;
+  d[2] = d[0] ^ d[1] ^ 0x5a;
+
+  sendDatagramOnFace( d , 3 , 0 );
+
+}
+
+void relay() {
+
+  if ( !isDatagramReadyOnFace( 3 ) ) return;
+
+  // Hold on to it until there is room to pass it on
+
+  if ( !eastEnd && !getDatagramSlotsFreeOnFace( 0 ) ) return;
+
+  const byte *d = getDatagramOnFace( 3 );
+
+  if ( getDatagramLengthOnFace( 3 ) != 3 || ( d[0] ^ d[1] ^ 0x5a ) != d[2] ) {
+
+    sp.println( "FAIL garbled" );
+    failures++;
+
+  } else {
+
+    word v = d[0] | ( d[1] << 8 );
+
+    if ( v != nextExpected ) {
+      sp.print( "FAIL expected " );
+      sp.print( nextExpected );
+      sp.print( " got " );
+      sp.println( v );
+      failures++;
+    }
+
+    nextExpected = v + 1;
+    count++;
+
+    if ( !eastEnd ) {
+      sendCount( v );
+    }
+
+  }
+
+  markDatagramReadOnFace( 3 );
+
+}
+
+void loop() {
+
+  if ( !started && millis() >= START_MS ) {
+    started = true;
+    westEnd = isValueReceivedOnFaceExpired( 3 );
+    eastEnd = isValueReceivedOnFaceExpired( 0 );
+  }
+
+  if ( started ) {
+
+    if ( westEnd ) {
+
+      while ( getDatagramSlotsFreeOnFace( 0 ) ) {
+        sendCount( nextSend++ );
+        count++;
+      }
+
+    } else {
+
+      relay();
+
+    }
+
+  }
+
+  if ( !reported && millis() >= REPORT_MS ) {
+
+    reported = true;
+
+    if ( failures || !count ) {
+      sp.print( "FAIL " );
+      sp.print( failures );
+      sp.print( " bad of " );
+      sp.println( count );
+    } else {
+      sp.print( "ok " );
+      sp.println( count );
+    }
+
+  }
+
+}
@@ -0,0 +1,24 @@
+#!/bin/sh
+#
+# Run a test sketch in the cluster and check that every tile printed a line starting with "ok" and none printed "FAIL".
+#
+# Usage: check.sh tile_count cluster tile.so [cluster options]...
+#
+# The cluster options must give a cluster with tile_count tiles.
+#
+
+tiles="$1"
+shift
+
+out=$( "$@" 2>&1 ) || { echo "$out" ; echo "FAIL: cluster exited with an error" ; exit 1 ; }
+
+fails=$( echo "$out" | grep -c "^tile [0-9]*: FAIL" )
+oks=$( echo "$out" | grep -c "^tile [0-9]*: ok" )
+
+if [ "$fails" -ne 0 ] || [ "$oks" -ne "$tiles" ] ; then
+    echo "$out"
+    echo "FAIL: $* ($oks of $tiles tiles ok, $fails failures)"
+    exit 1
+fi
+
+echo "ok: $* ($( echo "$out" | tail -n 1 ))"
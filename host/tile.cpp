@@ -0,0 +1,250 @@
+/*
+ * tile.cpp
+ *
+ * Runs a single sketch natively on top of the emulated BIOS.
+ *
+ * Mostly useful for profiling blinklib and sketches with real host tools (perf, gprof, valgrind) and
+ * for quickly checking that a sketch does what you think without flashing a tile.
+ *
+ * Usage: tile [-t ms] [-f frame_ms] [-p at_ms:duration_ms]... [-s seed] [-x] [-v]
+ *
+ *  -t  How many milliseconds of tile time to run (default 10000)
+ *  -f  How many milliseconds each pass though loop() takes (default 55, about 18 frames per second)
+ *  -p  Press the button at `at_ms` and hold it for `duration_ms`. Can be repeated.
+ *  -s  Seed for the serial number and randomize() entropy
+ *  -x  Fast forward. Instead of running loop() every frame, skip ahead to the next time something is due to happen
+ *      (a Timer going off, an IR probe, warm or cold sleep, a button event). Hours of tile time go by in a blink.
+ *  -v  Print each IR packet sent
+ *
+ * Service port output goes to stdout. Summary goes to stderr.
+ *
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <vector>
+#include <algorithm>
+
+#include "blinkbios_host.h"
+
+#define TILE_STACK_SIZE ( 256 * 1024 )
+
+struct button_event_t {
+    uint32_t at;
+    uint8_t down;
+
+    bool operator<( const button_event_t &other ) const {
+        return at < other.at;
+    }
+};
+
+static uint8_t verbose_flag;
+static uint8_t fast_forward_flag;
+
+static uint32_t ir_packets_sent;
+
+static uint8_t tile_ir_send( void *context , uint8_t face , const uint8_t *data , uint8_t len ) {
+
+    (void) context;
+
+    ir_packets_sent++;
+
+    if (verbose_flag) {
+
+        fprintf( stderr , "%8u IR face %u:" , blinkbios_host_millis() , face );
+
+        for( uint8_t i = 0 ; i < len ; i++ ) {
+            fprintf( stderr , " %02x" , data[i] );
+        }
+
+        fprintf( stderr , "\n" );
+    }
+
+    return 1;
+}
+
+static void tile_sp_tx( void *context , uint8_t b ) {
+
+    (void) context;
+
+    putchar( b );
+
+}
+
+static const char *step_name( uint8_t step ) {
+
+    switch (step) {
+        case BLINKBIOS_HOST_STEP_FRAME: return "running";
+        case BLINKBIOS_HOST_STEP_SPIN:  return "spinning";
+        case BLINKBIOS_HOST_STEP_SLEEP: return "cold sleep";
+        case BLINKBIOS_HOST_STEP_SEED:  return "seed mode";
+        case BLINKBIOS_HOST_STEP_ABEND: return "abend";
+    }
+
+    return "?";
+}
+
+static double host_seconds() {
+
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC , &ts );
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+
+}
+
+int main( int argc , char **argv ) {
+
+    uint32_t run_ms = 10000;
+    uint32_t frame_ms = 55;
+    uint32_t seed = 1;
+
+    std::vector<button_event_t> button_events;
+
+    int opt;
+
+    while ( (opt = getopt( argc , argv , "t:f:p:s:xv" )) != -1 ) {
+
+        switch (opt) {
+
+            case 't':
+                run_ms = strtoul( optarg , NULL , 0 );
+                break;
+
+            case 'f':
+                frame_ms = strtoul( optarg , NULL , 0 );
+                break;
+
+            case 'p': {
+                unsigned at , duration;
+                if ( sscanf( optarg , "%u:%u" , &at , &duration ) != 2 ) {
+                    fprintf( stderr , "Bad button press `%s`, should be at_ms:duration_ms\n" , optarg );
+                    return 1;
+                }
+                button_events.push_back( { at , 1 } );
+                button_events.push_back( { at + duration , 0 } );
+                break;
+            }
+
+            case 's':
+                seed = strtoul( optarg , NULL , 0 );
+                break;
+
+            case 'x':
+                fast_forward_flag = 1;
+                break;
+
+            case 'v':
+                verbose_flag = 1;
+                break;
+
+            default:
+                fprintf( stderr , "Usage: %s [-t ms] [-f frame_ms] [-p at_ms:duration_ms]... [-s seed] [-x] [-v]\n" , argv[0] );
+                return 1;
+        }
+
+    }
+
+    if ( frame_ms == 0 ) frame_ms = 1;
+
+    std::stable_sort( button_events.begin() , button_events.end() );
+
+    blinkbios_host_env_t env = { NULL , tile_ir_send , tile_sp_tx , seed };
+
+    blinkbios_host_boot( &env , malloc( TILE_STACK_SIZE ) , TILE_STACK_SIZE );
+
+    size_t next_button_event = 0;
+
+    uint32_t elapsed = 0;           // Tile time that has passed, including time asleep
+    uint32_t frames = 0;
+    uint32_t steps = 0;             // Includes the times we ran and the tile was spinning or asleep
+    uint8_t step = BLINKBIOS_HOST_STEP_FRAME;
+
+    double start = host_seconds();
+
+    while ( elapsed < run_ms ) {
+
+        step = blinkbios_host_step();
+
+        steps++;
+
+        if ( step == BLINKBIOS_HOST_STEP_SEED || step == BLINKBIOS_HOST_STEP_ABEND ) {
+            break;
+        }
+
+        if ( step == BLINKBIOS_HOST_STEP_FRAME ) {
+            frames++;
+        }
+
+        // How long did that step take in tile time?
+
+        uint32_t step_ms = ( step == BLINKBIOS_HOST_STEP_FRAME ) ? frame_ms : 1;
+
+        if ( fast_forward_flag ) {
+
+            // Nothing can change until the tile's next wake or the next button event, so no point in running before then
+
+            uint32_t next_wake = blinkbios_host_next_wake();
+            uint32_t skip_ms = run_ms - elapsed;
+
+            if ( next_wake != BLINKBIOS_HOST_NEVER ) {
+                skip_ms = std::min( skip_ms , next_wake - blinkbios_host_millis() );
+            }
+
+            if ( next_button_event < button_events.size() ) {
+                skip_ms = std::min( skip_ms , button_events[ next_button_event ].at - elapsed );
+            }
+
+            step_ms = std::max( step_ms , skip_ms );
+
+        }
+
+        uint32_t target = std::min( elapsed + step_ms , run_ms );
+
+        // Advance in pieces so button changes land on the right millisecond
+
+        while ( elapsed < target ) {
+
+            while ( next_button_event < button_events.size() && button_events[ next_button_event ].at <= elapsed ) {
+                blinkbios_host_set_button( button_events[ next_button_event ].down );
+                next_button_event++;
+            }
+
+            uint32_t chunk = target - elapsed;
+
+            if ( next_button_event < button_events.size() ) {
+                chunk = std::min( chunk , button_events[ next_button_event ].at - elapsed );
+            }
+
+            blinkbios_host_advance( chunk );
+            elapsed += chunk;
+
+        }
+
+    }
+
+    double host_elapsed = host_seconds() - start;
+
+    fflush( stdout );
+
+    fprintf( stderr , "Ran %u ms of tile time (millis=%u) in %.3f s host time\n" , elapsed , blinkbios_host_millis() , host_elapsed );
+    fprintf( stderr , "%u frames (%u steps), %.0f frames/s host, %u IR packets sent, ended %s\n" , frames , steps , host_elapsed > 0 ? frames / host_elapsed : 0.0 , ir_packets_sent , step_name( step ) );
+
+    fprintf( stderr , "Pixels:" );
+
+    for( uint8_t f = 0 ; f < 6 ; f++ ) {
+
+        uint16_t c = blinkbios_host_get_pixel( f );
+
+        // Unpack the 5 bit r,g,b fields of pixelColor_t
+
+        fprintf( stderr , " %02u/%02u/%02u" , ( c >> 1 ) & 0x1f , ( c >> 6 ) & 0x1f , ( c >> 11 ) & 0x1f );
+    }
+
+    fprintf( stderr , "\n" );
+
+    return 0;
+}
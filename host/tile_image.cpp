@@ -0,0 +1,159 @@
+/*
+ * tile_image.cpp
+ *
+ * See tile_image.h
+ *
+ */
+
+#ifndef _GNU_SOURCE
+    #define _GNU_SOURCE
+#endif
+
+#include <dlfcn.h>
+#include <link.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "tile_image.h"
+
+static void fail( const char *what , const char *detail ) {
+
+    fprintf( stderr , "%s: %s\n" , what , detail );
+    exit( 1 );
+
+}
+
+// The dynamic loader will give us back the same image if we dlopen() the same file twice,
+// so we make our own private copy of the file each time.
+
+static std::string make_private_copy( const char *path ) {
+
+    FILE *in = fopen( path , "rb" );
+
+    if (!in) fail( "Could not open tile image" , path );
+
+    char copy_path[] = "/tmp/tile_image_XXXXXX";
+
+    int fd = mkstemp( copy_path );
+
+    if ( fd < 0 ) fail( "Could not make temp file for" , path );
+
+    char buffer[ 64 * 1024 ];
+    size_t len;
+
+    while ( ( len = fread( buffer , 1 , sizeof( buffer ) , in ) ) > 0 ) {
+
+        if ( write( fd , buffer , len ) != (ssize_t) len ) fail( "Could not write copy of" , path );
+
+    }
+
+    fclose( in );
+    close( fd );
+
+    return copy_path;
+
+}
+
+// Finds the writable PT_LOAD segment of the image loaded at `base`
+
+struct find_segment_t {
+    ElfW(Addr) base;
+    uint8_t *start;
+    size_t size;
+};
+
+static int find_writable_segment( struct dl_phdr_info *info , size_t size , void *data ) {
+
+    (void) size;
+
+    find_segment_t *find = (find_segment_t *) data;
+
+    if ( info->dlpi_addr != find->base ) {
+        return 0;
+    }
+
+    for( int i = 0 ; i < info->dlpi_phnum ; i++ ) {
+
+        const ElfW(Phdr) *phdr = &info->dlpi_phdr[i];
+
+        if ( phdr->p_type == PT_LOAD && ( phdr->p_flags & PF_W ) ) {
+
+            find->start = (uint8_t *) ( info->dlpi_addr + phdr->p_vaddr );
+            find->size = phdr->p_memsz;
+
+            return 1;
+        }
+
+    }
+
+    return 0;
+
+}
+
+template <typename T> static void lookup( void *handle , const char *name , T &fn ) {
+
+    fn = (T) dlsym( handle , name );
+
+    if ( !fn ) fail( "Tile image is missing" , name );
+
+}
+
+TileImage::TileImage( const char *path ) {
+
+    m_copy_path = make_private_copy( path );
+
+    // RTLD_LOCAL so that the next copy does not bind to our symbols. The image is linked with -Bsymbolic so
+    // that it always binds to its own.
+
+    m_handle = dlopen( m_copy_path.c_str() , RTLD_NOW | RTLD_LOCAL );
+
+    if ( !m_handle ) fail( "Could not load tile image" , dlerror() );
+
+    struct link_map *map;
+
+    if ( dlinfo( m_handle , RTLD_DI_LINKMAP , &map ) != 0 ) fail( "Could not find tile image" , dlerror() );
+
+    find_segment_t find = { map->l_addr , NULL , 0 };
+
+    dl_iterate_phdr( find_writable_segment , &find );
+
+    if ( !find.start ) fail( "No writable segment in tile image" , path );
+
+    m_live = find.start;
+    m_size = find.size;
+
+    lookup( m_handle , "blinkbios_host_boot" , boot );
+    lookup( m_handle , "blinkbios_host_step" , step );
+    lookup( m_handle , "blinkbios_host_advance" , advance );
+    lookup( m_handle , "blinkbios_host_set_button" , set_button );
+    lookup( m_handle , "blinkbios_host_ir_receive" , ir_receive );
+    lookup( m_handle , "blinkbios_host_next_wake" , next_wake );
+    lookup( m_handle , "blinkbios_host_millis" , millis );
+    lookup( m_handle , "blinkbios_host_get_pixel" , get_pixel );
+
+    m_pristine = (uint8_t *) malloc( m_size );
+    swap_out( m_pristine );
+
+}
+
+TileImage::~TileImage() {
+
+    free( m_pristine );
+    dlclose( m_handle );
+    unlink( m_copy_path.c_str() );
+
+}
+
+void TileImage::swap_in( const uint8_t *state ) const {
+
+    memcpy( m_live , state , m_size );
+
+}
+
+void TileImage::swap_out( uint8_t *state ) const {
+
+    memcpy( state , m_live , m_size );
+
+}
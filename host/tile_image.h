@@ -0,0 +1,72 @@
+/*
+ * tile_image.h
+ *
+ * Lets one loaded copy of a tile image (a sketch + blinklib + emulated BIOS built as a shared object)
+ * stand in for any number of tiles.
+ *
+ * All of the state of a tile lives in the writable segment of the shared object, just like all of the state of a
+ * real tile lives in its 1K of RAM. So to run a tile we copy its saved state into that segment, step it, and then copy
+ * the segment back out. The only other thing a tile owns is the stack its foreground coroutine runs on.
+ *
+ * Each TileImage is a separate copy of the shared object (the file is copied so the dynamic loader will not hand us back
+ * the same one), so you can have one per thread.
+ *
+ */
+
+#ifndef TILE_IMAGE_H_
+#define TILE_IMAGE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "blinkbios_host.h"
+
+class TileImage {
+
+    public:
+
+        // Load a private copy of the tile image at `path`. Exits with a message on failure.
+
+        TileImage( const char *path );
+        ~TileImage();
+
+        // Size of the state of one tile
+
+        size_t state_size() const { return m_size; }
+
+        // State of a tile just after the image was loaded, before it has been booted
+
+        const uint8_t *pristine() const { return m_pristine; }
+
+        // Copy a tile's state into the live image so it can run, and back out when done
+
+        void swap_in( const uint8_t *state ) const;
+        void swap_out( uint8_t *state ) const;
+
+        // Entry points into the tile image. See blinkbios_host.h.
+        // These act on whatever tile is currently swapped in.
+
+        void     (*boot)( const blinkbios_host_env_t *env , void *stack , size_t stack_size );
+        uint8_t  (*step)( void );
+        void     (*advance)( uint32_t ms );
+        void     (*set_button)( uint8_t down );
+        uint8_t  (*ir_receive)( uint8_t face , const uint8_t *data , uint8_t len );
+        uint32_t (*next_wake)( void );
+        uint32_t (*millis)( void );
+        uint16_t (*get_pixel)( uint8_t face );
+
+    private:
+
+        std::string m_copy_path;
+        void *m_handle;
+
+        uint8_t *m_live;            // The writable segment of the loaded image
+        size_t m_size;
+
+        uint8_t *m_pristine;
+
+};
+
+#endif /* TILE_IMAGE_H_ */